@@ -73,6 +73,13 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
 
 
 /// TYPEDEFS ///
@@ -87,6 +94,17 @@ enum cre_kind {
     // NOTE: Unicode is not supported... this is left as an exercise for the reader
     cre_SET,
 
+    // matches epsilon, but records the current position in a tag (for capture groups)
+    cre_TAG,
+
+    // matches epsilon, but only at a word boundary ('\b'), or only not at one ('\B'), where
+    //   a word boundary is between a word character (see '\w') and a non-word character
+    //   (or the start/end of the input)
+    // NOTE: whether the next byte is a word character isn't known until it is fed, so
+    //         engines keep these nodes (like SET nodes) until then
+    cre_WORDB,
+    cre_NWORDB,
+
 };
 
 // regular expression NFA node structure
@@ -99,12 +117,17 @@ struct cre_node {
     // outward edges of the NFA node (as indices into an array of nodes), OR:
     //   -1: empty/no edge
     //   -2: open edge that is unlinked, which means a match state
+    //   -2 - i: (in a 'cre_set') a match state for pattern 'i'
     int u, v;
 
     // if kind==cre_SET, this is the set of characters that this node matches
     // NOTE: as mentioned, Unicode is note supported, and so only 256 characters are supported, corresponding to ASCII (first 128), and byte values
     bool *set;
 
+    // if kind==cre_TAG, this is the tag that this node records, which is 2*g for
+    //   the start of capture group 'g', and 2*g+1 for its end
+    int tag;
+
 };
 
 // regular expression pattern, which can be used to search or validate text
@@ -119,6 +142,12 @@ typedef struct {
     // which node in 'nfa' to start matching with
     int nfa_start;
 
+    // number of capture groups, i.e. '(...)', not counting the whole match (group 0)
+    int ngroups;
+
+    // number of patterns, which is 1 unless this is part of a 'cre_set'
+    int npats;
+
     // the source the pattern was compiled from
     // NOTE: this is just for debugging purposes, and is not used during the actual search
     char* src;
@@ -126,334 +155,6710 @@ typedef struct {
 } cre_pat;
 
 
-// regular expression state simulator, used to simulate the NFA state machine
-// NOTE: this only tells whether something has matched, not what the
-//         matching substring/groups is/are. for that, use 'cre_iter'
+// result of a search, which is either whether a match was found, or a negative
+//   code telling why the search was stopped early
+enum cre_res {
+    // no match was found (yet)
+    cre_NOMATCH = 0,
+
+    // a match was found
+    cre_MATCH = 1,
+
+    // the search was stopped because it went over one of the limits in its 'cre_budget'
+    cre_BUDGET = -1,
+
+    // the search was stopped because its cancellation flag was set
+    cre_CANCEL = -2,
+
+};
+
+// zero-width inputs, which can be fed to a simulator with 'cre_sim_feedz'
+enum cre_z {
+    // start a new match attempt at the current position (i.e. for unanchored searches)
+    cre_START,
+
+    // the end of the input, which is where word boundaries after the last byte are decided
+    cre_END,
+
+};
+
+// limits on how much work a single search may do, for when patterns and/or input
+//   come from untrusted sources
+// a limit of 0 means 'unlimited', so a zero-initialized budget has no limits
+// NOTE: compiling doesn't take a budget, since it is bounded by hard limits instead:
+//         patterns have at most 'cre_MAX_NODES' NFA nodes (and 'cre_MAX_DEPTH' nested
+//         groups), and 'cre_pat_analyze' (which 'cre_srch_init' calls) takes at most
+//         'cre_ANALYZE_STEPS' steps for each part, so an untrusted pattern takes at most
+//         tens of MB and a fraction of a second to compile
 typedef struct {
 
-    // the pattern being searched for (should not change!)
-    cre_pat* pat;
+    // maximum number of input bytes that may be fed
+    size_t max_bytes;
 
-    // bitset representing the current state(s) of the NFA, i.e. 'in[s]' tells whether
-    //   the NFA is currently in state 's'
-    // possible optimization: http://c-faq.com/misc/bitsets.html
-    bool* in;
-    
-    // another array of inputs, used as ping-pong buffers to efficiently feed the iterator
-    bool* lastin;
+    // maximum number of steps (NFA nodes visited) that may be taken
+    size_t max_steps;
 
-} cre_sim;
+    // maximum number of DFA states that may be created, for engines that create them
+    int max_states;
 
+    // maximum bytes of memory (see 'cre_mem') that engines may grow to while building
+    //   states, after which they stop with 'cre_BUDGET' (or, if they can, continue with the
+    //   simulator instead)
+    size_t max_memory;
 
-// internal structure that represents a single
-struct cre_iter_path {
+    // wall-clock deadline, as an absolute time (in nanoseconds) from 'cre_now()'
+    int64_t deadline;
 
-    // simulator used for this path
-    cre_sim sim;
+    // if non-NULL, the search is stopped soon after '*cancel' becomes nonzero
+    // NOTE: this is meant to be set from another thread (or a signal handler)
+    volatile int* cancel;
 
-    // match start (inclusive) and end (exclusive) as positions
-    int Ms, Me;
+} cre_budget;
 
-    // group start (inclusive) and end (exclusive) as positions
-    int *Gs, *Ge;
+
+// engines that a pattern can be searched with
+enum cre_engine {
+    // simulating the NFA directly (see 'cre_sim')
+    cre_ENGINE_SIM,
+
+    // tagged DFA (see 'cre_tdfa'), for patterns with capture groups
+    cre_ENGINE_TDFA,
+
+    // lazy DFA (see 'cre_dfa'), for patterns without capture groups
+    cre_ENGINE_DFA,
+
+    // bitset simulator (see 'cre_bsim'), for patterns whose DFA explodes
+    cre_ENGINE_BSIM,
 
 };
 
-// regular expression search iterator, used to iterate over matches found
-typedef struct {
+// most NFA nodes that a pattern may compile to, after which 'cre_pat_init' fails (so that
+//   compiling an untrusted pattern takes bounded time and memory, of about 300 bytes per
+//   node, since repetitions like '(a{1000}){1000}' multiply)
+#define cre_MAX_NODES 65536
 
-    // length and capacity of the array
-    int paths_len, paths_cap;
+// most groups that may be nested in a pattern, after which 'cre_pat_init' fails (since it
+//   parses them recursively)
+#define cre_MAX_DEPTH 256
 
-    // array of paths, which are valid paths that have been initialized
-    struct cre_iter_path* paths;
+// maximum number (and length) of literal factors reported by 'cre_pat_analyze'
+#define cre_MAX_FACTORS 4
+#define cre_MAX_FACTOR_LEN 64
 
-    // length and capacity of the input buffer
-    int buf_len, buf_cap;
+// maximum number of DFA states that 'cre_pat_analyze' explores before deciding
+//   that the DFA explodes
+#define cre_ANALYZE_STATES 10000
 
-    // input buffer
-    char* buf;
+// maximum number of steps (about one per NFA node visited) that each part of
+//   'cre_pat_analyze' takes, after which it gives up and assumes the worst (e.g. that the
+//   DFA explodes), so that analyzing a pattern takes bounded time however big it is
+#define cre_ANALYZE_STEPS (1 << 24)
 
-} cre_iter;
+// maximum number of NFA nodes for which 'cre_pat_analyze' looks for literal factors
+//   (which takes O(nfa_len^2) time)
+#define cre_ANALYZE_FACTOR_NODES 4096
 
+// report on what a pattern will cost to search, from 'cre_pat_analyze'
+typedef struct {
 
-/// API ///
+    // number of NFA nodes, and how many bytes they take up (including sets)
+    int nfa_len;
+    size_t nfa_bytes;
 
-// make a new regular expression pattern from 'src', returns NULL (if successful),
-//   or a string describing the error. you should pass the error string to 'free()'
-//   when you are done with it
-// NOTE: call 'cre_pat_free(pat)' when you're done with it
-char*
-cre_pat_init(cre_pat* pat, const char* src);
+    // number of byte classes (i.e. groups of bytes that the pattern never distinguishes)
+    int nclasses;
 
-// free a regular expression pattern's resources/memory
-void
-cre_pat_free(cre_pat* pat);
+    // number of states in the DFA for the pattern, or -1 if there are more
+    //   than 'cre_ANALYZE_STATES' (or exploring them takes more than 'cre_ANALYZE_STEPS'),
+    //   in which case 'dfa_explodes' is true
+    int dfa_states;
+    bool dfa_explodes;
 
+    // minimum and maximum length (in bytes) of a match, where 'max_len' is -1 if
+    //   matches can be arbitrarily long
+    int min_len, max_len;
 
-// initialize a simulator with a given pattern
-// NOTE: call 'cre_sim_free(sim)' when you're done with it
-void
-cre_sim_init(cre_sim* sim, cre_pat* pat);
+    // literal that every match starts with (not NUL-terminated)
+    int prefix_len;
+    char prefix[cre_MAX_FACTOR_LEN];
 
-// free an simulator's resources/memory
-void
-cre_sim_free(cre_sim* sim);
+    // literals that every match contains, longest first (not NUL-terminated)
+    int nfactors;
+    int factors_len[cre_MAX_FACTORS];
+    char factors[cre_MAX_FACTORS][cre_MAX_FACTOR_LEN];
 
-// reset the simulator's state, as if it were just created
-void
-cre_sim_reset(cre_sim* sim);
+    // whether the pattern is one-pass, i.e. at each point in a match, the next byte
+    //   decides which way the NFA goes (which is false if checking takes more than
+    //   'cre_ANALYZE_STEPS')
+    bool onepass;
 
-// feed a single character to the simulator, returning whether it is in
-//   a matching state
-bool
-cre_sim_feedc(cre_sim* sim, char c);
+    // engine that searches would use, along with the most steps it takes per input byte
+    //   (i.e. the worst-case time is 'steps_per_byte * len'), and the bytes of memory
+    //   it needs besides the pattern
+    enum cre_engine engine;
+    int steps_per_byte;
+    size_t engine_bytes;
 
+} cre_analysis;
 
-// initialize an iterator with a given pattern
-// NOTE: call 'cre_iter_free(iter)' when you're done with it
-void
-cre_iter_init(cre_iter* iter, cre_pat* pat);
+// memory used by a pattern or engine, in bytes, broken down by what it is for (from the
+//   'cre_*_memory_usage' functions)
+// NOTE: this counts what the struct points to, plus the tables inside it (like byte
+//         classes), but not the rest of the struct, nor the pattern an engine was made for
+//         (which is counted by 'cre_pat_memory_usage'), nor malloc's own overhead
+typedef struct {
 
-// initialize an iterator's resources/memory
-void
-cre_iter_free(cre_iter* iter);
+    // the compiled pattern: NFA nodes, their sets and the source (or the literals, for a
+    //   'cre_lits')
+    size_t nfa;
 
-// reset the iterator's state, as if it were just created
-void
-cre_iter_reset(cre_iter* iter);
+    // byte class tables (see 'cre_pat_classes')
+    size_t classes;
 
-// feed a single character to the iterator, returning whether there were any
-//   finalized matches produced
-bool
-cre_iter_feedc(cre_iter* iter, char c);
+    // DFA states, their transitions and lookup tables, which is a cache that grows while
+    //   searching (up to the engine's limit on states)
+    size_t dfa;
 
-//// HEADER END ////
+    // tables for skipping ahead to where a match may start
+    size_t prefilter;
 
+    // scratch space for searching (which each thread searching at once needs its own of)
+    size_t scratch;
 
+    // all of the above
+    size_t total;
 
+} cre_mem;
 
-/// IMPL ///
 
-//// IMPL: cre_pat ////
+// register sources in the operations of a 'cre_tdfa', besides other registers
+#define cre_TDFA_POS  -1
+#define cre_TDFA_NONE -2
 
-static int
-cre_parse_(cre_pat* pat, const char* src);
+// default limits on the size of a 'cre_tdfa' (if the budget doesn't give one)
+#define cre_TDFA_MAX_STATES 4096
+#define cre_TDFA_MAX_REGS   4096
 
-char*
-cre_pat_init(cre_pat* pat, const char* src) {
-    // first, copy over the source for debugging purposes
-    int sl = strlen(src);
-    pat->src = malloc(sl + 1);
-    memcpy(pat->src, src, sl);
-    pat->src[sl] = '\0';
+// tagged DFA (TDFA), which finds the leftmost-longest match, along with its capture groups,
+//   in a single deterministic pass (instead of simulating the NFA for every path)
+// each DFA state is an ordered (by priority) list of NFA threads, and each thread has a
+//   register for each tag. transitions carry register operations, which either copy a
+//   register from the previous state's threads, or set it to the current position
+// NOTE: the overall match is leftmost-longest, and the groups within it follow the NFA's
+//         priority (i.e. repetition is greedy, and earlier alternatives are preferred)
+typedef struct {
 
-    // start out with no NFA nodes
-    pat->nfa_len = 0;
-    pat->nfa = NULL;
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
 
-    // now, actually parse and return the start state
-    pat->nfa_start = cre_parse_(pat, src);
+    // number of tags, which is 2 * (ngroups + 1), and registers (ntags per thread)
+    int ntags, nregs;
 
-    // no error
-    return NULL;
-}
+    // byte classes (see 'cre_pat_classes')
+    uint8_t cls[256];
+    int ncls;
 
-void
-cre_pat_free(cre_pat* pat) {
-    free(pat->src);
-    free(pat->nfa);
-}
+    // number of states, and the state that searches start in
+    int nstates, start;
 
+    // transition table, where 'trans[s * ncls + c]' is the state after class 'c' from state 's'
+    int* trans;
 
-//// IMPL: cre_sim ////
+    // register operations, as '(dst, src)' pairs, where 'src' is a register, 'cre_TDFA_POS'
+    //   (the current position), or 'cre_TDFA_NONE' (unset). the operations for transition 't'
+    //   (an index into 'trans') are 'ops[2 * opsoff[t]]' up to 'ops[2 * opsoff[t + 1]]', and
+    //   the operations for entering the start state are before 'opsoff[0]'
+    int* opsoff;
+    int* ops;
 
-void
-cre_sim_init(cre_sim* sim, cre_pat* pat) {
-    sim->pat = pat;
-    sim->in = malloc(sizeof(*sim->in) * pat->nfa_len);
-    sim->lastin = malloc(sizeof(*sim->lastin) * pat->nfa_len);
+    // for each state, the thread that accepts (or -1), and whether there are any threads
+    //   left that could still match (if not, a search can stop)
+    int* acc;
+    bool* live;
 
-    // start off by resetting it
-    cre_sim_reset(iter);
-}
+    // registers, and scratch space for applying operations
+    int64_t* regs;
+    int64_t* tmp;
 
-void
-cre_sim_free(cre_sim* sim) {
-    free(sim->in);
-    free(sim->lastin);
-}
+} cre_tdfa;
 
-void
-cre_sim_reset(cre_sim* sim) {
-    // initialize everything to false
-    int i;
-    for (i = 0; i < pat->nfa_len; i++) {
-        sim->in[i] = sim->lastin[i] = false;
-    }
-    // then, set the start state to true
-    sim->in[sim->pat->nfa_start] = true;
-}
 
-// add a state
-static bool
-cre_sim_add_(cre_sim* sim, int i) {
-    if (i == -1) {
-        // empty/nothing further
-        return false;
-    } else if (i == -2) {
-        // match/accept
-        return true;
-    }
+// kinds of nodes in the regex AST used by 'cre_drv'
+enum cre_drv_kind {
+    // matches nothing
+    cre_DRV_EMPTY,
 
-    // should have handled special signals/values
-    assert(i >= 0);
-    // should be in range
-    assert(i < sim->pat->nfa_len);
+    // matches the empty string
+    cre_DRV_EPS,
 
-    bool res = false;
+    // matches a single byte in a set
+    cre_DRV_SET,
 
-    struct cre_node* n = &sim->pat->nfa[i];
-    if (sim->pat->nfa[i].kind == cre_EPS) {
-        // on epsilon nodes, simulate an instant transition to those states
-        // NOTE: an simulator should never be "in" a state that is an epsilon node, since
-        //         by definition it should instantly transition out as well
-        if (cre_sim_add_(sim, n->u)) res = true;
-        if (cre_sim_add_(sim, n->v)) res = true;
-    } else {
-        // not epsilon, so transition directly and record it
-        sim->in[i] = true;
-    }
+    // matches 'a' followed by 'b'
+    cre_DRV_CAT,
 
-    return res;
-}
+    // matches 'a' or 'b' (a|b)
+    cre_DRV_ALT,
 
-bool
-cre_sim_feedc(cre_sim* sim, char c) {
-    // swap buffers, since we're about to overwrite them
-    bool* tmp = sim->in;
-    sim->in = sim->lastin;
-    sim->lastin = tmp;
+    // matches both 'a' and 'b' (a&b)
+    cre_DRV_AND,
 
-    // clear what states we are in
-    int i;
-    for (i = 0; i < sim->pat->nfa_len; i++) {
-        sim->in[i] = false;
-    }
+    // matches anything that 'a' doesn't (~a)
+    cre_DRV_NOT,
 
-    bool res = false;
+    // matches 'a' any number of times (a*)
+    cre_DRV_STAR,
 
-    // now, traverse where we were in (lastin), and see if we can transition to any new states,
-    //   and add those to the current states we're in
-    for (i = 0; i < sim->pat->nfa_len; i++) {
-        if (sim->lastin[i]) {
-            struct cre_node* n = &sim->pat->nfa[i];
+};
 
-            // whether the current character ('c') matches the current node
-            bool valid = false;
-            if (n->kind == cre_SET) {
-                valid = n->set[c];
-            }
+// node in the regex AST used by 'cre_drv'
+// NOTE: nodes are hash-consed, so equal nodes have the same index
+struct cre_drv_node {
 
-            if (valid) {
-                // since this state is valid, try to transition to other states as well (recursively)
-                if (cre_sim_add_(sim, n->u)) res = true;
-                if (cre_sim_add_(sim, n->v)) res = true;
-            }
-        }
-    }
+    // what kind of node is this (see 'cre_DRV_*')
+    enum cre_drv_kind kind;
 
-    return res;
-}
+    // children (indices of other nodes), or -1 if not used
+    int a, b;
 
-//// IMPL: cre_iter ////
+    // if kind==cre_DRV_SET, the bytes that this node matches (as a bitset)
+    uint64_t set[4];
 
-void
-cre_iter_init(cre_iter* iter, cre_pat* pat) {
-    iter->pat = pat;
+    // whether this node matches the empty string
+    bool nullable;
 
-    iter->paths_cap = iter->paths_len = 0;
-    iter->paths = NULL;
+    // DFA state for this node, or -1 if it isn't one (yet)
+    int state;
 
-    iter->buf_cap = iter->buf_len = 0;
-    iter->buf_len = 0;
+};
 
-    // start off by resetting it
-    cre_iter_reset(iter);
-}
+// default maximum number of DFA states kept in a 'cre_drv' before it flushes its cache
+#define cre_DRV_CACHE_STATES 4096
 
-void
-cre_iter_free(cre_iter* iter) {
-    int i;
-    for (i = 0; i < iter->paths_cap; i++) {
-        struct cre_path* p = &iter->paths[i];
-        // free each path's resources
-        cre_sim_free(&p->sim);
-        free(p->Gs);
-        free(p->Ge);
-    }
-    free(iter->paths);
-    free(iter->buf);
-}
+// derivative-based regex engine, which also supports intersection ('a&b') and
+//   complement ('~a'), so rules like "contains X but not Y" (i.e. '.*X.*&~(.*Y.*)')
+//   can be checked in one pass
+// DFA states are built lazily, as (Brzozowski) derivatives of the regex with respect
+//   to each byte class, and the cache of states is flushed when it fills up
+// NOTE: '~' applies to the atom (and repetition) right after it, and '&' binds tighter
+//         than '|' but looser than concatenation
+typedef struct {
 
-void
-cre_iter_reset(cre_iter* iter) {
-    // reset lengths to 0, but don't free
-    iter->paths_len = 0;
-    iter->buf_len = 0;
-}
+    // the source the regex was compiled from
+    char* src;
 
-// feed a single character to the iterator, returning whether there were any
-//   finalized matches produced
-bool
-cre_iter_feedc(cre_iter* iter, char c) {
-    int i, j;
+    // AST nodes
+    int nodes_len, nodes_cap;
+    struct cre_drv_node* nodes;
 
-    // whether we have already added a new path
-    bool has_newpath = false;
-    for (i = 0; i < iter->paths_len; ++i) {
-        struct cre_iter_path* p = &iter->paths[i];
-        cre_sim* s = &p->sim;
-        if (!has_newpath && p->Ms < 0) {
-            // we don't have a new path yet, so add one
-            p->Ms = iter->buf_len;
-            p->Me = -1;
-            has_newpath = true;
-        } else if (!has_newpath && i == iter->paths_len - 1) {
-            // on last iteration and still don't have a new path, so append
-            // NOTE: this will cause there to be an extra iteration to handle it
-            if (iter->paths_len >= iter->paths_cap) {
-                // reallocate to append new state
-                iter->paths_cap = iter->paths_len * 2 + 4;
-                iter->paths = realloc(iter->paths, sizeof(*iter->paths) * iter->paths_cap);
-                for (i = iter->paths_len; i < iter->paths_cap; ++i) {
-                    struct cre_iter_path* p = &iter->paths[i];
-                    cre_sim_init(&p->sim, iter->pat);
-                    p->Gs = malloc(sizeof(*p->Gs) * iter->pat->nfa_len);
-                    p->Ge = malloc(sizeof(*p->Gs) * iter->pat->nfa_len);
-                }
-            }
-            // start a new path to match
-            iter->paths[iter->paths_len].Ms = iter->buf_len;
-            iter->paths[iter->paths_len].Me = -1;
-            iter->paths_len++;
-            has_newpath = true;
-        } 
-        if (p->Ms >= 0) {
-            // active path, so feed it
-            bool ismatch = cre_sim_feedc(s, c);
-            if (ismatch) {
-                // have a match, so update the end to the longest match
-                p->Me = iter->buf_len;
-            }   
-            // whether it has any state left (i.e. could still match)
-            bool has_instate = false;
-            for (j = 0; !has_instate && j < s->nfa_len; ++j) {
-                has_instate = s->in[j];
-            }
+    // hash table of nodes (indices, or -1 for empty slots)
+    int* tab;
+    int tab_cap;
 
-            if (!has_instate) {
-                // done with this path, so remove it and/or add match
+    // the regex, and the regex with '(.|\n)*' in front (for searching)
+    int root, uroot;
+
+    // byte classes (which don't change when taking derivatives)
+    uint8_t cls[256];
+    int ncls;
+
+    // DFA states: the node of each, and their transitions ('trans[s * ncls + c]', or -1
+    //   if not computed yet)
+    int nstates, max_states;
+    int* snode;
+    int* trans;
+
+    // number of times the cache has been flushed
+    int nflush;
+
+} cre_drv;
+
+
+// approximate matcher, which finds where the pattern matches with at most 'k' errors
+//   (insertions, deletions or substitutions, i.e. edit distance), using the bit-parallel
+//   algorithm from Wu and Manber (taking O(k) word operations per byte)
+// NOTE: this only works for patterns that are a sequence of up to 64 sets (i.e. literals
+//         and classes, without alternation or repetition)
+typedef struct {
+
+    // number of sets in the pattern, and number of errors allowed
+    int len, k;
+
+    // for each byte, which positions in the pattern it matches (as a bitset)
+    uint64_t masks[256];
+
+    // state for each number of errors 'd', where bit 'i' of 'R[d]' tells whether
+    //   the first 'i+1' sets of the pattern match (with 'd' errors) ending here
+    uint64_t* R;
+
+} cre_apx;
+
+
+// default maximum number of states in a 'cre_dfa'
+#define cre_DFA_MAX_STATES 10000
+
+// lazily-built DFA for a pattern (or a 'cre_set'), where each state is a set of SET nodes
+//   in the NFA, along with which patterns have a match that ends when entering it
+// a forward DFA searches unanchored (a match may start at any position), and a reverse
+//   DFA runs backwards from where a match ends, to find where it starts
+// NOTE: states are never flushed, so state numbers stay valid for the life of the DFA,
+//         and once there are 'max_states' of them, searches return 'cre_BUDGET'
+typedef struct {
+
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
+
+    // whether this is a reverse DFA
+    bool reverse;
+
+    // byte classes (see 'cre_pat_classes')
+    uint8_t cls[256];
+    int ncls;
+
+    // follow lists: after SET node 'n' matches a byte, the SET nodes that may match the
+    //   next byte (or the previous byte, for a reverse DFA) are 'fol[foloff[n]]' up to
+    //   'fol[foloff[n + 1]]', and the patterns that match are 'fac[facoff[n]]' up to
+    //   'fac[facoff[n + 1]]' (for a reverse DFA, this is 0 if a match may start there)
+    int* foloff;
+    int* fol;
+    int* facoff;
+    int* fac;
+
+    // entry lists: the SET nodes that may match the first byte, which is 'ent[entoff[e]]'
+    //   up to 'ent[entoff[e + 1]]' for entry 'e'. forward DFAs have one entry (which is
+    //   also added at every position), and reverse DFAs have one for each pattern
+    int nent;
+    int* entoff;
+    int* ent;
+
+    // patterns that match the empty string
+    int nnull;
+    int* null;
+
+    // number of states, and the most that may be created
+    int nstates, states_cap, max_states;
+
+    // the SET nodes in state 's' are 'snodes[soff[s]]' up to 'snodes[soff[s + 1]]', and the
+    //   patterns matching on entering it are 'apats[aoff[s]]' up to 'apats[aoff[s + 1]]'
+    // NOTE: with word boundaries, the states also have the word boundary nodes waiting on
+    //         the next byte, and 'nfa_len' if the last byte was a word character, and a
+    //         pattern 'p' that matched just before the last byte is 'npats + p'
+    int* soff;
+    int* snodes;
+    int snodes_cap;
+    int* aoff;
+    int* apats;
+    int apats_cap;
+
+    // transitions, 'trans[s * ncls + c]' (or -1 if not computed yet)
+    int* trans;
+
+    // state for each entry (or -1 if not computed yet), and then (with word boundaries)
+    //   for each entry after a word character
+    int* start;
+
+    // whether the pattern has word boundaries, and if so, whether a match ends at the end
+    //   of the input in each state (i.e. from a word boundary there)
+    bool words;
+    bool* eoi;
+
+    // hash table of states
+    int* tab;
+    int tab_cap;
+
+    // how many times each state was entered while profiling (see 'cre_dfa_profile'), or
+    //   NULL if it hasn't been
+    uint64_t* visits;
+
+    // scratch space for computing transitions
+    bool* mark;
+    int* list;
+    bool* pmark;
+    int* plist;
+    bool* cmark;
+    int* clist;
+
+} cre_dfa;
+
+// packed DFA, which is a whole forward DFA (see 'cre_dfa') built ahead of time and stored
+//   in as small a table as it fits in, for patterns (or sets) whose DFA is small enough to
+//   build, and which are searched a lot
+// the encoding is chosen for each pattern:
+//   * rows have a column for each byte class, not for each byte
+//   * states are numbered by where their row starts (i.e. premultiplied by the number of
+//     classes), so following a transition doesn't need a multiply
+//   * state numbers are 8, 16 or 32 bits, whichever is the smallest that fits
+//   * states entered in a sample (see 'cre_dfa_profile') have dense rows, and come first,
+//     and the rest have sparse rows, which are runs of classes that go to the same state
+typedef struct {
+
+    // byte classes (see 'cre_pat_classes')
+    uint8_t cls[256];
+    int ncls;
+
+    // bytes in a state number (1, 2 or 4)
+    int width;
+
+    // number of states with dense and sparse rows
+    // NOTE: dense state 'i' is numbered 'i * ncls', and sparse state 'j' is numbered
+    //         'ndense * ncls + j'
+    int ndense, nsparse;
+
+    // dense rows, of 'ncls' state numbers (of 'width' bytes) each
+    void* dense;
+
+    // sparse rows, where the row of sparse state 'j' is runs 'roff[j]' up to 'roff[j + 1]',
+    //   and run 'r' goes to state 'rto[r]' for the classes after the last run up to 'rhi[r]'
+    int* roff;
+    uint8_t* rhi;
+    uint32_t* rto;
+
+    // bitsets of the states in which a match ends on entering them, and in which a match
+    //   ends at the end of the input (from a word boundary there)
+    uint64_t* acc;
+    uint64_t* eoi;
+
+    // the start state, and whether the pattern matches the empty string
+    uint32_t start;
+    bool null;
+
+} cre_pdfa;
+
+// callback for each match found by 'cre_ovl_search', given the pattern index and
+//   the start and end offsets, and returning whether to keep going
+typedef bool (*cre_ovl_fn)(void* ctx, int pat, size_t start, size_t end);
+
+// overlapping match enumerator, which finds every (start, end) pair that matches, using a
+//   forward DFA to find where matches end, and a reverse DFA from there to find the starts
+typedef struct {
+
+    // forward and reverse DFAs
+    cre_dfa fwd, rev;
+
+    // scratch space for the patterns that end at the current position, and which are
+    //   already in it (with room for every pattern)
+    int* ends;
+    bool* mark;
+
+} cre_ovl;
+
+// set of patterns, which are combined into one NFA, so they can be searched together
+typedef struct {
+
+    // number of patterns
+    int len;
+
+    // the combined pattern, in which a match for pattern 'i' is the open edge '-2 - i'
+    cre_pat pat;
+
+} cre_set;
+
+// multi-literal searcher, for (very) large sets of literal strings, using the algorithm
+//   from Wu and Manber: a window as long as the shortest literal is moved along the text,
+//   skipping ahead by how far the hash of its last few bytes is from the end of any
+//   literal's window, and checking the literals in that hash's bucket when it is 0
+// NOTE: memory is proportional to the number (and bytes) of literals, unlike an automaton
+typedef struct {
+
+    // number of literals, and their bytes, where literal 'i' is 'bytes[off[i]]' up to
+    //   'bytes[off[i + 1]]'
+    int len;
+    char* bytes;
+    size_t* off;
+
+    // length of the window (i.e. the shortest literal), and of the blocks that are hashed
+    //   (which is at most 8)
+    int m, B;
+
+    // number of bits in a block hash
+    int tbits;
+
+    // how far to skip for each block hash
+    uint16_t* shift;
+
+    // literals whose window ends with each block hash, which are 'ids[head[h]]' up to
+    //   'ids[head[h + 1]]', along with the first (up to 4) bytes of each literal
+    int* head;
+    int* ids;
+    uint32_t* fp;
+
+} cre_lits;
+
+// one compiled version of a 'cre_rules' rule set
+typedef struct cre_rules_ver {
+
+    // version number, which goes up by one with each swap
+    uint64_t version;
+
+    // the rules (which should not be changed)
+    cre_set set;
+
+    // the epoch when this version was replaced, and the next replaced version that is
+    //   waiting to be freed
+    uint64_t retired;
+    struct cre_rules_ver* next;
+
+} cre_rules_ver;
+
+// maximum number of threads that can search a 'cre_rules' at once
+#define cre_RULES_MAX_READERS 256
+
+// rule set that can be swapped for a newly compiled one while it is being searched
+// searches 'enter' to get the current version, and 'leave' when they are done with it, and
+//   swapping publishes a new version atomically, and frees old versions once no search that
+//   started before the swap is still running (i.e. epoch-based reclamation, like RCU)
+// NOTE: the fields marked atomic are only accessed with '__atomic' builtins, so that this
+//         also works when included in C++
+typedef struct {
+
+    // the current version (atomic)
+    cre_rules_ver* cur;
+
+    // the current epoch, which starts at 1 and goes up with each swap (atomic)
+    uint64_t epoch;
+
+    // bitmap of the reader slots that are being used (atomic)
+    uint64_t used[(cre_RULES_MAX_READERS + 63) / 64];
+
+    // the epoch each reader entered in, or 0 if it isn't searching (atomic)
+    uint64_t slots[cre_RULES_MAX_READERS];
+
+    // replaced versions, waiting to be freed (only used with 'lock' held)
+    cre_rules_ver* retired;
+
+    // most bytes of memory (see 'cre_mem') that a new version may use, counting its pattern
+    //   and one reader's simulator, or 0 for no limit
+    // NOTE: this is 0 after 'cre_rules_init', and may be set any time before a swap
+    size_t max_memory;
+
+    // lock for swapping, so that only one thread swaps at a time
+    // NOTE: searches never take this
+    pthread_mutex_t lock;
+
+} cre_rules;
+
+// compiled pattern (or set) laid out in one block of memory with offsets instead of
+//   pointers, so that it can be put in shared memory (e.g. a file or 'memfd' that is mapped
+//   read-only) and used by many processes, none of which have to compile it
+// the block has the NFA (with its character sets) and, unless it has too many states, the
+//   whole forward DFA, so that searching it never has to add to it
+typedef struct {
+
+    // the pattern, whose character sets (and source) point into the block
+    // NOTE: the nodes are copied out of the block, since they have pointers, but they are
+    //         small next to the sets
+    cre_set set;
+
+    // the forward DFA, whose tables point into the block, or 'dfa.nstates == 0' if the
+    //   block doesn't have one
+    // NOTE: since it is complete, 'cre_dfa_search' only reads it, so any number of threads
+    //         can search it at once
+    cre_dfa dfa;
+
+    // the block, and whether it was mapped by 'cre_img_map'
+    const void* data;
+    size_t size;
+    bool mapped;
+
+} cre_img;
+
+// set of patterns split into shards (each with its own DFA), so that sets whose combined DFA
+//   is too big to build can be searched with one thread per shard
+// patterns are split by how big their DFAs are, so that the ones that grow it the most
+//   (e.g. 'a.*b') are spread out over the shards
+typedef struct {
+
+    // number of patterns, and of shards
+    int len;
+    int nshards;
+
+    // the patterns in each shard, where pattern 'i' of shard 'k' is 'pats[off[k] + i]' (in
+    //   the whole set)
+    cre_set* shards;
+    int* off;
+    int* pats;
+
+    // lazy DFA for each shard, which is also the scratch space for the thread searching it
+    // NOTE: these are kept between searches, but are cleared whenever they get too big
+    cre_dfa* dfas;
+
+} cre_shard;
+
+
+// regular expression state simulator, used to simulate the NFA state machine
+// NOTE: this only tells whether something has matched, not what the
+//         matching substring/groups is/are. for that, use 'cre_iter'
+typedef struct {
+
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
+
+    // bitset representing the current state(s) of the NFA, i.e. 'in[s]' tells whether
+    //   the NFA is currently in state 's'
+    // NOTE: epsilon nodes that were passed through are also marked, so that each node
+    //         is only visited once per character
+    // possible optimization: http://c-faq.com/misc/bitsets.html
+    bool* in;
+    
+    // another array of inputs, used as ping-pong buffers to efficiently feed the iterator
+    bool* lastin;
+
+    // stack of nodes to visit, used when adding states (so that we don't recurse)
+    int* stack;
+
+    // number of bytes fed and steps taken since the last reset, which are checked
+    //   against a 'cre_budget' by the bulk searching functions
+    size_t nbytes, nsteps;
+
+    // whether the pattern matches the empty string (i.e. the start state accepts)
+    bool null;
+
+    // whether the pattern has word boundaries, and if so, whether the last byte fed was a
+    //   word character
+    bool words, word;
+
+    // while deciding word boundaries, whether the current position is one (otherwise -1)
+    int bound;
+
+} cre_sim;
+
+// most NFA nodes that a 'cre_bsim' is made for, since its tables grow with the square of it
+#define cre_BSIM_MAX_NODES 4096
+
+// bitset simulator, which simulates the NFA like 'cre_sim', but keeps the SET nodes it is in
+//   as a bitset (of 64-bit words, by node index), and moves them all at once with tables of
+//   bitsets: the SET nodes that match each byte class, and the SET nodes that follow each
+//   SET node after it matches
+// this takes about the same time for every byte, so it is for patterns whose DFA explodes
+//   but that are small enough for the tables (see 'cre_BSIM_MAX_NODES')
+// NOTE: every position also starts a match attempt (like a forward 'cre_dfa'), and patterns
+//         with word boundaries aren't supported
+typedef struct {
+
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
+
+    // number of words in a bitset
+    int nwords;
+
+    // byte classes (see 'cre_pat_classes'), and the SET nodes that match class 'k', which
+    //   are 'cmask[k * nwords]' up to 'cmask[(k + 1) * nwords]'
+    uint8_t cls[256];
+    int ncls;
+    uint64_t* cmask;
+
+    // the SET nodes that follow SET node 'n' are the bitset 'fol[row[n] * nwords]', which is
+    //   only nonzero in words 'lo[row[n]]' up to 'hi[row[n]]' (which are all that are used)
+    int* row;
+    int* lo;
+    int* hi;
+    uint64_t* fol;
+
+    // SET nodes that may match the first byte of a match, and that complete a match
+    uint64_t* ent;
+    uint64_t* acc;
+
+    // SET nodes that it is currently in, and scratch space for the next ones
+    uint64_t* in;
+    uint64_t* tmp;
+
+    // whether the pattern matches the empty string
+    bool null;
+
+    // number of bytes fed and steps (bitsets combined) taken since the last reset, which
+    //   are checked against a 'cre_budget' (see 'cre_sim')
+    size_t nbytes, nsteps;
+
+} cre_bsim;
+
+// default number of bytes between checkpoints in a 'cre_ckpt'
+#define cre_CKPT_EVERY 4096
+
+// list of checkpoints, which are (offset, state) pairs sorted by offset
+struct cre_ckpt_list {
+
+    // number of checkpoints, and how many there is room for
+    size_t len, cap;
+
+    // offset of each checkpoint, i.e. the state is what it is after the bytes before it
+    size_t* off;
+
+    // DFA state of each checkpoint (if not 'nfa')
+    int* state;
+
+    // or, the active SET nodes (and waiting word boundaries) of each checkpoint (if 'nfa'),
+    //   as a bitset of 'nwords' words each, whose last bit is whether the last byte was a
+    //   word character
+    uint64_t* bits;
+
+};
+
+// callback for each position where a match ends, found by a 'cre_ckpt'
+typedef void (*cre_end_fn)(void* ctx, size_t end);
+
+// checkpointed scanner, for re-matching text after it is edited
+// the state of the (unanchored) search is saved every so often, so that after an edit the
+//   search can resume from the last checkpoint before it, and stop as soon as its state
+//   is the same as an old checkpoint after it (since everything after that is the same)
+// NOTE: states are DFA state numbers, unless the DFA got too big, in which case they
+//         are bitsets of the NFA's SET nodes instead
+typedef struct {
+
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
+
+    // (minimum) number of bytes between checkpoints
+    size_t every;
+
+    // whether NFA bitsets are used as the states, instead of the DFA
+    bool nfa;
+
+    // the DFA and simulator used for scanning
+    cre_dfa dfa;
+    cre_sim sim;
+
+    // number of words in a bitset
+    int nwords;
+
+    // the current checkpoints, and the old ones (from before an edit)
+    struct cre_ckpt_list cur, old;
+
+} cre_ckpt;
+
+// streaming searcher, which searches with the DFA (or the simulator, if the DFA would be
+//   too big), or approximately with a 'cre_apx', and skips ahead with a literal
+//   prefilter when no match attempt is in progress
+// NOTE: its state is kept between calls, so a stream can be searched in pieces
+typedef struct {
+
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
+
+    // engine being used, which is 'cre_ENGINE_DFA', or (if the DFA explodes, or gets too big
+    //   while searching) 'cre_ENGINE_BSIM' if the pattern allows it, and otherwise
+    //   'cre_ENGINE_SIM'
+    enum cre_engine engine;
+
+    // whether to match approximately instead (with 'apx')
+    bool approx;
+
+    // the engines, and the current DFA state
+    cre_dfa dfa;
+    cre_sim sim;
+    cre_apx apx;
+    int s;
+
+    // the bitset simulator, and whether it has been made (which is only done once it is
+    //   used)
+    cre_bsim bsim;
+    bool has_bsim;
+
+    // literal that every match starts with (see 'cre_analysis.prefix'), used as a prefilter
+    char prefix[cre_MAX_FACTOR_LEN];
+    int prefix_len;
+
+    // number of SET nodes (and waiting word boundaries) that the simulator is in when no
+    //   match attempt is in progress
+    int nidle;
+
+    // number of bytes searched since the last reset, which is checked against a 'cre_budget'
+    size_t nbytes;
+
+    // unique number for this searcher, so saved states know whether their DFA state
+    //   numbers are still valid
+    uint64_t gen;
+
+} cre_srch;
+
+// resumable search of a buffer with a streaming searcher, which searches a slice of it at a
+//   time (see 'cre_search_step'), so that a long search can be interleaved with other work
+//   (e.g. an event loop) without a thread
+// NOTE: all of its state is 'pos' and the searcher's state, so it can be saved compactly
+//         with 'cre_srch_save' (and resumed by loading it and setting 'pos')
+typedef struct {
+
+    // the searcher, and the buffer being searched
+    cre_srch* srch;
+    const char* src;
+    size_t len;
+
+    // how much of the buffer has been searched
+    size_t pos;
+
+    // whether the end of the buffer has been checked, so the search is done
+    bool done;
+
+} cre_step;
+
+
+// internal structure that represents a single
+struct cre_iter_path {
+
+    // simulator used for this path
+    cre_sim sim;
+
+    // match start (inclusive) and end (exclusive) as positions
+    int Ms, Me;
+
+    // group start (inclusive) and end (exclusive) as positions
+    int *Gs, *Ge;
+
+};
+
+// regular expression search iterator, used to iterate over matches found
+typedef struct {
+
+    // the pattern being searched for (should not change!)
+    cre_pat* pat;
+
+    // length and capacity of the array
+    int paths_len, paths_cap;
+
+    // array of paths, which are valid paths that have been initialized
+    struct cre_iter_path* paths;
+
+    // length and capacity of the input buffer
+    int buf_len, buf_cap;
+
+    // input buffer
+    char* buf;
+
+} cre_iter;
+
+
+/// API ///
+
+// make a new regular expression pattern from 'src', returns NULL (if successful),
+//   or a string describing the error. you should pass the error string to 'free()'
+//   when you are done with it
+// NOTE: patterns that would have more than 'cre_MAX_NODES' NFA nodes, or more than
+//         'cre_MAX_DEPTH' nested groups, are errors, so this always takes bounded time and
+//         memory (see 'cre_budget')
+// NOTE: call 'cre_pat_free(pat)' when you're done with it
+char*
+cre_pat_init(cre_pat* pat, const char* src);
+
+// free a regular expression pattern's resources/memory
+void
+cre_pat_free(cre_pat* pat);
+
+// analyze a pattern, filling in 'res' with a report of what it will cost to search
+//   (i.e. so that expensive patterns can be rejected before they are used)
+void
+cre_pat_analyze(cre_pat* pat, cre_analysis* res);
+
+// compute the byte classes of a pattern (bytes that no set in the pattern distinguishes),
+//   storing the class of each byte in 'cls' and returning the number of classes
+int
+cre_pat_classes(cre_pat* pat, uint8_t* cls);
+
+// get the memory used by a pattern (see 'cre_mem')
+void
+cre_pat_memory_usage(cre_pat* pat, cre_mem* res);
+
+// return 'cre_BUDGET' if 'mem' is over the memory limit of 'budget' (which may be NULL),
+//   or 'cre_NOMATCH' otherwise
+// NOTE: this is for rejecting a pattern (or rule set) before searching with it, e.g. by
+//         adding up the usage of the pattern and the engines (and scratch) it needs
+int
+cre_mem_check(const cre_mem* mem, const cre_budget* budget);
+
+// return the name of an engine, i.e. "sim"
+const char*
+cre_engine_name(enum cre_engine engine);
+
+
+// initialize a simulator with a given pattern
+// NOTE: call 'cre_sim_free(sim)' when you're done with it
+void
+cre_sim_init(cre_sim* sim, cre_pat* pat);
+
+// free an simulator's resources/memory
+void
+cre_sim_free(cre_sim* sim);
+
+// reset the simulator's state, as if it were just created
+void
+cre_sim_reset(cre_sim* sim);
+
+// feed a single character to the simulator, returning whether it is in
+//   a matching state
+// NOTE: a match that ends at a word boundary is only known once the byte after it is fed
+//         (or 'cre_END'), so it is reported then
+bool
+cre_sim_feedc(cre_sim* sim, char c);
+
+// feed a zero-width input (see 'cre_z') to the simulator, returning whether it is in
+//   a matching state afterwards
+// NOTE: 'cre_END' only decides the match attempts that are active, so for a match that
+//         starts at the end to be found, 'cre_START' must be fed after the last byte
+bool
+cre_sim_feedz(cre_sim* sim, enum cre_z z);
+
+// feed 'len' bytes from 'src' to the simulator, starting a new match attempt at each
+//   position, until a match ends or the 'budget' runs out ('budget' may be NULL)
+// returns a 'cre_res', and on 'cre_MATCH', sets '*end' to the offset just past the
+//   first byte that completed a match, so that searching can be resumed at 'src+*end'
+// NOTE: the counters in 'sim' aren't cleared between calls, so a stream can be searched
+//         in pieces under a single budget. call 'cre_sim_reset(sim)' between searches
+// NOTE: since the input may continue, a match ending at a word boundary at the very end
+//         is only found by feeding 'cre_END' afterwards (which also tries a match that
+//         starts there)
+int
+cre_sim_search(cre_sim* sim, const char* src, size_t len, const cre_budget* budget, size_t* end);
+
+// get the memory used by a simulator (see 'cre_mem'), which is all scratch space
+void
+cre_sim_memory_usage(cre_sim* sim, cre_mem* res);
+
+
+// initialize a bitset simulator, returning NULL on success or an error string (which should
+//   be passed to 'free()') if the pattern has word boundaries or too many nodes
+// NOTE: call 'cre_bsim_free(b)' when you're done with it
+char*
+cre_bsim_init(cre_bsim* b, cre_pat* pat);
+
+// free a bitset simulator's resources/memory
+void
+cre_bsim_free(cre_bsim* b);
+
+// reset the bitset simulator's state, as if it were just created
+void
+cre_bsim_reset(cre_bsim* b);
+
+// feed a single character to the bitset simulator, returning whether a match ends after it
+bool
+cre_bsim_feedc(cre_bsim* b, char c);
+
+// search 'len' bytes of 'src' (like 'cre_sim_search', continuing from the current state)
+int
+cre_bsim_search(cre_bsim* b, const char* src, size_t len, const cre_budget* budget, size_t* end);
+
+// get the memory used by a bitset simulator (see 'cre_mem')
+void
+cre_bsim_memory_usage(cre_bsim* b, cre_mem* res);
+
+// return the current time (in nanoseconds) from a monotonic clock, which is what
+//   'cre_budget.deadline' is compared against
+int64_t
+cre_now(void);
+
+
+// build a tagged DFA for a pattern, within the limits of 'budget' ('max_states', plus
+//   the deadline and cancellation flag, and it may be NULL)
+// returns 0 on success, or a negative 'cre_res' if the TDFA would be too big (in which
+//   case nothing needs to be freed, and captures should be found with another engine)
+// NOTE: call 'cre_tdfa_free(d)' when you're done with it
+int
+cre_tdfa_init(cre_tdfa* d, cre_pat* pat, const cre_budget* budget);
+
+// free a tagged DFA's resources/memory
+void
+cre_tdfa_free(cre_tdfa* d);
+
+// search 'len' bytes of 'src' for the leftmost-longest match, returning a 'cre_res'
+// on 'cre_MATCH', 'groups[2*g]' and 'groups[2*g+1]' are set to the start and end offsets
+//   of group 'g' (or -1 if it didn't participate), for 'g' from 0 (the whole match)
+//   to 'pat->ngroups'
+// NOTE: only 'max_bytes', the deadline and the cancellation flag of 'budget' are used
+int
+cre_tdfa_search(cre_tdfa* d, const char* src, size_t len, const cre_budget* budget, int64_t* groups);
+
+// get the memory used by a tagged DFA (see 'cre_mem')
+void
+cre_tdfa_memory_usage(cre_tdfa* d, cre_mem* res);
+
+
+// compile a regex (which may use '&' and '~') for the derivative engine, returning NULL
+//   on success or an error string (which should be passed to 'free()')
+// 'cache_states' is how many DFA states to keep before flushing (0 for the default)
+// NOTE: call 'cre_drv_free(d)' when you're done with it
+char*
+cre_drv_init(cre_drv* d, const char* src, int cache_states);
+
+// free a derivative engine's resources/memory
+void
+cre_drv_free(cre_drv* d);
+
+// check whether all 'len' bytes of 'src' match the regex, returning a 'cre_res'
+int
+cre_drv_match(cre_drv* d, const char* src, size_t len, const cre_budget* budget);
+
+// search 'len' bytes of 'src' for the first position where a match ends (like
+//   'cre_sim_search'), returning a 'cre_res' and setting '*end' on 'cre_MATCH'
+// NOTE: 'max_states' in 'budget' limits how many states may be built during the search
+int
+cre_drv_search(cre_drv* d, const char* src, size_t len, const cre_budget* budget, size_t* end);
+
+// get the memory used by a derivative engine (see 'cre_mem'), which counts the AST nodes
+//   made while searching as part of its DFA (since they are flushed along with it)
+void
+cre_drv_memory_usage(cre_drv* d, cre_mem* res);
+
+
+// initialize an approximate matcher for a pattern, allowing 'k' errors (which is limited to
+//   the pattern's length, since that many already match anything), returning NULL on
+//   success or an error string (which should be passed to 'free()')
+// NOTE: call 'cre_apx_free(a)' when you're done with it
+char*
+cre_apx_init(cre_apx* a, cre_pat* pat, int k);
+
+// free an approximate matcher's resources/memory
+void
+cre_apx_free(cre_apx* a);
+
+// reset the approximate matcher's state, as if it were just created
+void
+cre_apx_reset(cre_apx* a);
+
+// feed a single character to the approximate matcher, returning the fewest errors a match
+//   ending here has, or -1 if there isn't one
+int
+cre_apx_feedc(cre_apx* a, char c);
+
+// search 'len' bytes of 'src' for the first position where a match ends (like
+//   'cre_sim_search'), returning a 'cre_res', and setting '*end' and '*errs' (the
+//   number of errors) on 'cre_MATCH'
+int
+cre_apx_search(cre_apx* a, const char* src, size_t len, const cre_budget* budget, size_t* end, int* errs);
+
+// get the memory used by an approximate matcher (see 'cre_mem')
+void
+cre_apx_memory_usage(cre_apx* a, cre_mem* res);
+
+
+// make a set from 'len' patterns, returning NULL on success or an error string (which
+//   should be passed to 'free()')
+// NOTE: call 'cre_set_free(set)' when you're done with it
+char*
+cre_set_init(cre_set* set, const char** srcs, int len);
+
+// free a set's resources/memory
+void
+cre_set_free(cre_set* set);
+
+// get the memory used by a set (see 'cre_mem'), which is its combined pattern
+void
+cre_set_memory_usage(cre_set* set, cre_mem* res);
+
+
+// initialize a (forward or reverse) DFA for a pattern, which may have at most 'max_states'
+//   states (0 for 'cre_DFA_MAX_STATES')
+// NOTE: call 'cre_dfa_free(d)' when you're done with it
+void
+cre_dfa_init(cre_dfa* d, cre_pat* pat, bool reverse, int max_states);
+
+// free a DFA's resources/memory
+void
+cre_dfa_free(cre_dfa* d);
+
+// return the state after 'c' from state 's' (building it if needed), or -1 if there
+//   are too many states
+int
+cre_dfa_next(cre_dfa* d, int s, char c);
+
+// return the state for an entry (see 'cre_dfa.ent'), or -1 if there are too many states
+int
+cre_dfa_entry(cre_dfa* d, int e);
+
+// search 'len' bytes of 'src' for the first position where a match ends (like
+//   'cre_sim_search'), returning a 'cre_res', and setting '*end' on 'cre_MATCH'
+// NOTE: this should be a forward DFA, and 'src' is the whole input (so, word boundaries
+//         at the end of it are decided)
+// NOTE: 'max_memory' in 'budget' limits how big the DFA may grow during the search
+int
+cre_dfa_search(cre_dfa* d, const char* src, size_t len, const cre_budget* budget, size_t* end);
+
+// get the memory used by a DFA (see 'cre_mem')
+void
+cre_dfa_memory_usage(cre_dfa* d, cre_mem* res);
+
+// run a forward DFA over all of 'src' (a sample of what it will search), counting how many
+//   times each state is entered in 'd->visits', returning a 'cre_res' (which is
+//   'cre_NOMATCH' once it has run over all of it, even if there were matches)
+// NOTE: the counts add up over calls, so a sample may be given in pieces
+int
+cre_dfa_profile(cre_dfa* d, const char* src, size_t len, const cre_budget* budget);
+
+// renumber the states of a profiled DFA, so that the ones entered most come first (and the
+//   rest keep their order), which puts the transitions that are used most close together
+// NOTE: this changes state numbers, so nothing may be holding on to any (e.g. a 'cre_srch'
+//         or 'cre_ovl' using it)
+void
+cre_dfa_relayout(cre_dfa* d);
+
+
+// initialize a packed DFA for a pattern, building its whole forward DFA if it has at most
+//   'max_states' states (or 'cre_DFA_MAX_STATES' if 'max_states <= 0'), returning NULL on
+//   success or an error string (which should be passed to 'free()')
+// if 'len > 0', 'src' is a sample of what it will search, and only the states entered in it
+//   get dense rows (otherwise, they all do)
+// NOTE: call 'cre_pdfa_free(p)' when you're done with it
+char*
+cre_pdfa_init(cre_pdfa* p, cre_pat* pat, int max_states, const char* src, size_t len);
+
+// free a packed DFA's resources/memory
+void
+cre_pdfa_free(cre_pdfa* p);
+
+// search with a packed DFA (like 'cre_dfa_search')
+// NOTE: it never changes, so any number of threads can search it at once
+int
+cre_pdfa_search(const cre_pdfa* p, const char* src, size_t len, const cre_budget* budget, size_t* end);
+
+// get the memory used by a packed DFA (see 'cre_mem')
+void
+cre_pdfa_memory_usage(cre_pdfa* p, cre_mem* res);
+
+
+// initialize an overlapping match enumerator for a pattern (see 'cre_dfa_init')
+// NOTE: call 'cre_ovl_free(o)' when you're done with it
+void
+cre_ovl_init(cre_ovl* o, cre_pat* pat, int max_states);
+
+// free an overlapping match enumerator's resources/memory
+void
+cre_ovl_free(cre_ovl* o);
+
+// call 'fn' for every match in 'src' (including overlapping ones), ordered by end, then
+//   empty matches first, then pattern, then start (latest first), returning a 'cre_res'
+//   (which is 'cre_MATCH' if any matches were found)
+// NOTE: matches are found without allocating anything (after the DFAs are warmed up), but
+//         since it keeps scratch space, only one thread may search with it at once
+int
+cre_ovl_search(cre_ovl* o, const char* src, size_t len, const cre_budget* budget, cre_ovl_fn fn, void* ctx);
+
+// get the memory used by an overlapping match enumerator (see 'cre_mem'), which is mostly
+//   its two DFAs
+void
+cre_ovl_memory_usage(cre_ovl* o, cre_mem* res);
+
+
+// initialize a checkpointed scanner for a pattern, with a checkpoint every 'every' bytes
+//   (0 for 'cre_CKPT_EVERY')
+// NOTE: call 'cre_ckpt_free(c)' when you're done with it
+void
+cre_ckpt_init(cre_ckpt* c, cre_pat* pat, size_t every);
+
+// free a checkpointed scanner's resources/memory
+void
+cre_ckpt_free(cre_ckpt* c);
+
+// scan a whole document, calling 'fn' at each position where a match ends (like
+//   'cre_sim_search'), and making new checkpoints
+// returns a 'cre_res', which is 'cre_NOMATCH' on success
+// NOTE: only the deadline and cancellation flag of 'budget' are used, and if the scan is
+//         stopped early, the checkpoints only cover what was scanned
+int
+cre_ckpt_scan(cre_ckpt* c, const char* src, size_t len, const cre_budget* budget, cre_end_fn fn, void* ctx);
+
+// re-scan a document after 'old_len' bytes at 'pos' were replaced with 'new_len' bytes
+//   ('src' and 'len' are the whole new document), calling 'fn' for each match end that
+//   was re-scanned
+// '*from' and '*to' are set to the range that was re-scanned, so that matches ending in
+//   '(*from, *to]' (i.e. not at '*from' itself) should be replaced, and everything outside
+//   of it is unchanged (shifted by 'new_len - old_len' after the edit)
+// returns a 'cre_res', like 'cre_ckpt_scan'
+int
+cre_ckpt_edit(cre_ckpt* c, const char* src, size_t len, size_t pos, size_t old_len, size_t new_len, const cre_budget* budget, cre_end_fn fn, void* ctx, size_t* from, size_t* to);
+
+// get the memory used by a checkpointed scanner (see 'cre_mem'), which counts the
+//   checkpoints as part of its DFA (since they grow with the document)
+void
+cre_ckpt_memory_usage(cre_ckpt* c, cre_mem* res);
+
+
+// initialize a streaming searcher for a pattern, which allows 'k' errors (or matches
+//   exactly, if 'k < 0'), returning NULL on success or an error string (which should be
+//   passed to 'free()')
+// NOTE: this analyzes the pattern (see 'cre_pat_analyze') to pick an engine, which takes
+//         bounded time, and DFA states are only built while searching (within the budget
+//         of the search)
+// NOTE: call 'cre_srch_free(s)' when you're done with it
+char*
+cre_srch_init(cre_srch* s, cre_pat* pat, int k);
+
+// free a streaming searcher's resources/memory
+void
+cre_srch_free(cre_srch* s);
+
+// reset the streaming searcher's state, as if it were just created
+void
+cre_srch_reset(cre_srch* s);
+
+// search a chain of 'n' buffers, as if they were one buffer of all of them in order,
+//   starting at offset 'from' (in that one buffer), for the first position where a match
+//   ends (like 'cre_sim_search')
+// returns a 'cre_res', and on 'cre_MATCH' sets '*end' to the offset (in that one buffer)
+//   just past the byte that completed the match, so that searching can be resumed with
+//   'from = *end'
+// NOTE: matches (and prefilter literals) may span buffers, and continue into the
+//         buffers passed to the next call
+int
+cre_search_iov(cre_srch* s, const struct iovec* iov, int n, size_t from, const cre_budget* budget, size_t* end);
+
+// return how many bytes a saved state of the streaming searcher takes
+size_t
+cre_srch_state_size(cre_srch* s);
+
+// save the streaming searcher's state (i.e. where it is in a stream) to 'state', so that
+//   one searcher can be used for many streams, by loading each one's state before
+//   searching it (with 'cre_srch_load'), and saving it afterwards
+void
+cre_srch_save(cre_srch* s, void* state);
+
+// load a state saved with 'cre_srch_save'
+// NOTE: states saved before the searcher switched from the DFA to the simulator are
+//         converted when they are loaded, and states may also be loaded into another
+//         searcher for the same pattern (even in another process), which rebuilds the
+//         DFA state from the NFA nodes
+void
+cre_srch_load(cre_srch* s, const void* state);
+
+// return 'cre_MATCH' if a match would end at the end of the input, if it ended here
+//   (which is only possible when a word boundary there completes it), or 'cre_NOMATCH'
+// NOTE: this doesn't change the searcher's state, so more input may still follow (for
+//         example, when a file is appended to)
+int
+cre_srch_end(cre_srch* s);
+
+// get the memory used by a streaming searcher (see 'cre_mem')
+// NOTE: if 'max_memory' in the budget of a search is reached, the DFA stops growing, and
+//         the search continues with the simulator (it is checked along with the rest of
+//         the budget, so it may go over by the states added in between)
+void
+cre_srch_memory_usage(cre_srch* s, cre_mem* res);
+
+// start a resumable search of the 'len' bytes at 'src' with 's' (which is reset)
+void
+cre_step_init(cre_step* st, cre_srch* s, const char* src, size_t len);
+
+// search the next slice of a resumable search, which is at most 'max_bytes' bytes, and stops
+//   after about 'max_ns' nanoseconds (either of which may be 0, for no limit)
+// returns 'cre_MATCH' when a match is found (setting '*end' to the offset in the buffer just
+//   past where it ends), 'cre_BUDGET' when the slice is used up (so it should be called
+//   again later), or 'cre_NOMATCH' once the whole buffer has been searched
+// NOTE: the time is checked every 'cre_CHECK_EVERY' bytes, so slices may run a bit over
+int
+cre_search_step(cre_step* st, size_t max_bytes, int64_t max_ns, size_t* end);
+
+
+// initialize a multi-literal searcher for 'len' literals (of 'lens[i]' bytes each, which
+//   may contain any bytes), returning NULL on success or an error string (which should be
+//   passed to 'free()')
+// NOTE: call 'cre_lits_free(l)' when you're done with it
+char*
+cre_lits_init(cre_lits* l, const char** lits, const size_t* lens, int len);
+
+// free a multi-literal searcher's resources/memory
+void
+cre_lits_free(cre_lits* l);
+
+// search 'len' bytes of 'src' for the leftmost literal (the first one given, if several
+//   start at the same place), returning a 'cre_res', and setting '*start', '*end' and
+//   '*which' (the literal's index) on 'cre_MATCH'
+// NOTE: unlike 'cre_sim_search', matches are found in order of where they start
+int
+cre_lits_search(cre_lits* l, const char* src, size_t len, const cre_budget* budget, size_t* start, size_t* end, int* which);
+
+// get the memory used by a multi-literal searcher (see 'cre_mem')
+void
+cre_lits_memory_usage(cre_lits* l, cre_mem* res);
+
+
+// initialize a rule set with 'len' patterns, returning NULL on success or an error string
+//   (which should be passed to 'free()')
+// NOTE: call 'cre_rules_free(r)' when you're done with it
+char*
+cre_rules_init(cre_rules* r, const char** srcs, int len);
+
+// free a rule set (and every version of it)
+// NOTE: nothing should be searching it anymore
+void
+cre_rules_free(cre_rules* r);
+
+// get a reader slot for a thread that will search the rule set, or -1 if all
+//   'cre_RULES_MAX_READERS' of them are being used
+// NOTE: a slot belongs to one thread (which may enter and leave with it any number of
+//         times), until it is given back with 'cre_rules_release', so threads that come
+//         and go (e.g. in a pool) should give theirs back before they exit
+int
+cre_rules_reader(cre_rules* r);
+
+// give back a reader slot from 'cre_rules_reader' (which shouldn't be in a search), so that
+//   another thread can get it
+void
+cre_rules_release(cre_rules* r, int slot);
+
+// start a search in reader slot 'slot', returning the current version, which stays valid
+//   until 'cre_rules_leave(r, slot)'
+// NOTE: scratch space (i.e. a 'cre_sim') is tied to a version, so re-initialize it when
+//         the version number is different from last time
+cre_rules_ver*
+cre_rules_enter(cre_rules* r, int slot);
+
+// end a search in reader slot 'slot'
+void
+cre_rules_leave(cre_rules* r, int slot);
+
+// compile 'len' patterns and make them the current version, returning NULL on success or
+//   an error string (which should be passed to 'free()'), in which case nothing changes
+//   (i.e. if they don't compile, or they would use more than 'r->max_memory')
+// NOTE: compiling happens before anything is locked, so searches don't wait for it, and
+//         searches that already entered keep using the old version
+char*
+cre_rules_swap(cre_rules* r, const char** srcs, int len);
+
+// free the replaced versions that no search is using anymore, returning how many are
+//   still in use
+// NOTE: this is called by 'cre_rules_swap', but may be called any time to free them sooner
+int
+cre_rules_reclaim(cre_rules* r);
+
+// build the shared memory block for a pattern (or the pattern of a 'cre_set'), building its
+//   forward DFA ahead of time if it has at most 'max_states' states (or 'cre_DFA_MAX_STATES'
+//   if 'max_states <= 0'), and returning it with its size in '*size'
+// NOTE: the block should be passed to 'free()', usually after writing it to a file
+void*
+cre_img_build(cre_pat* pat, int max_states, size_t* size);
+
+// like 'cre_img_build', but first profiles the DFA over 'len' bytes of 'src' (a sample of
+//   what it will search), so that the states entered most are first in the block (see
+//   'cre_dfa_profile' and 'cre_dfa_relayout')
+void*
+cre_img_build_profiled(cre_pat* pat, int max_states, const char* src, size_t len, size_t* size);
+
+// use a block from 'cre_img_build' at 'data', returning NULL on success or an error string
+//   (which should be passed to 'free()') if it is not a valid block
+// NOTE: the block must stay valid (and unchanged) until 'cre_img_free(img)'
+char*
+cre_img_load(cre_img* img, const void* data, size_t size);
+
+// map a file (or 'memfd') holding a block from 'cre_img_build' read-only, and use it (see
+//   'cre_img_load'), returning NULL on success or an error string (which should be passed
+//   to 'free()')
+// NOTE: the mapping is shared, so every process using the same file shares its memory
+char*
+cre_img_map(cre_img* img, int fd);
+
+// free an image's resources/memory, and unmap its block if it was mapped
+// NOTE: the pattern and DFA must not be freed with 'cre_set_free'/'cre_dfa_free'
+void
+cre_img_free(cre_img* img);
+
+// initialize a sharded set of 'len' patterns with (at most) 'k' shards, returning NULL on
+//   success or an error string (which should be passed to 'free()')
+// NOTE: call 'cre_shard_free(sh)' when you're done with it
+char*
+cre_shard_init(cre_shard* sh, const char** srcs, int len, int k);
+
+// free a sharded set's resources/memory
+void
+cre_shard_free(cre_shard* sh);
+
+// search all of 'src' with a thread for each shard, setting bit 'i' of 'matched' (which has
+//   room for 'len' bits) if pattern 'i' matches anywhere, and returning whether any did
+// NOTE: the budget applies to each thread, and if any of them stop early, so does the
+//         result (but 'matched' still has what was found)
+// NOTE: the shards have scratch space, so only one search may run at a time
+int
+cre_shard_search(cre_shard* sh, const char* src, size_t len, const cre_budget* budget, uint64_t* matched);
+
+// get the memory used by a sharded set (see 'cre_mem'), including each shard's pattern
+void
+cre_shard_memory_usage(cre_shard* sh, cre_mem* res);
+
+
+// initialize an iterator with a given pattern
+// NOTE: call 'cre_iter_free(iter)' when you're done with it
+void
+cre_iter_init(cre_iter* iter, cre_pat* pat);
+
+// initialize an iterator's resources/memory
+void
+cre_iter_free(cre_iter* iter);
+
+// reset the iterator's state, as if it were just created
+void
+cre_iter_reset(cre_iter* iter);
+
+// feed a single character to the iterator, returning whether there were any
+//   finalized matches produced
+bool
+cre_iter_feedc(cre_iter* iter, char c);
+
+// get the memory used by an iterator (see 'cre_mem'), which is all scratch space
+void
+cre_iter_memory_usage(cre_iter* iter, cre_mem* res);
+
+#if defined(__cplusplus) && __cplusplus >= 202002L
+
+// C++20 adapter for resumable searches, as a coroutine that yields matches as they are found
+// usage:
+//   cre::search_gen g = cre::search(&srch, src, len, 1 << 16, 1000000);
+//   while (g.next()) {
+//       if (g.value()) ... a match ends at *g.value()
+//       else ... the slice is used up, so do other work before resuming it
+//   }
+// NOTE: this is C++ even if the header is included in an 'extern "C"' block
+
+extern "C++" {
+
+#include <coroutine>
+#include <optional>
+
+namespace cre {
+
+// generator of a resumable search, which yields where each match ends, and 'std::nullopt'
+//   when a slice is used up
+class search_gen {
+public:
+    struct promise_type {
+        std::optional<size_t> value;
+        search_gen get_return_object() { return search_gen(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(std::optional<size_t> v) noexcept { value = v; return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { throw; }
+    };
+
+    explicit search_gen(std::coroutine_handle<promise_type> h) : h_(h) {}
+    search_gen(search_gen&& o) noexcept : h_(o.h_) { o.h_ = nullptr; }
+    search_gen(const search_gen&) = delete;
+    ~search_gen() { if (h_) h_.destroy(); }
+
+    // resume the search until it yields again, returning false once it is done
+    bool next() {
+        if (!h_ || h_.done()) return false;
+        h_.resume();
+        return !h_.done();
+    }
+
+    // what it yielded last
+    std::optional<size_t> value() const { return h_.promise().value; }
+
+private:
+    std::coroutine_handle<promise_type> h_;
+};
+
+// search the 'len' bytes at 'src' with 's', in slices (see 'cre_search_step')
+inline search_gen
+search(cre_srch* s, const char* src, size_t len, size_t max_bytes, int64_t max_ns) {
+    cre_step st;
+    cre_step_init(&st, s, src, len);
+    size_t end;
+    while (true) {
+        int res = cre_search_step(&st, max_bytes, max_ns, &end);
+        if (res == cre_MATCH) co_yield end;
+        else if (res == cre_BUDGET) co_yield std::nullopt;
+        else co_return;
+    }
+}
+
+}
+
+}
+
+#endif
+
+//// HEADER END ////
+
+
+
+
+/// IMPL ///
+
+//// IMPL: cre_pat ////
+
+static int
+cre_parse_(cre_pat* pat, const char* src, char** err);
+
+char*
+cre_pat_init(cre_pat* pat, const char* src) {
+    // first, copy over the source for debugging purposes
+    int sl = strlen(src);
+    pat->src = malloc(sl + 1);
+    memcpy(pat->src, src, sl);
+    pat->src[sl] = '\0';
+
+    // start out with no NFA nodes
+    pat->nfa_len = 0;
+    pat->nfa = NULL;
+    pat->ngroups = 0;
+    pat->npats = 1;
+
+    // now, actually parse and return the start state
+    char* err = NULL;
+    pat->nfa_start = cre_parse_(pat, src, &err);
+    if (err) {
+        cre_pat_free(pat);
+        return err;
+    }
+
+    // no error
+    return NULL;
+}
+
+void
+cre_pat_free(cre_pat* pat) {
+    int i;
+    for (i = 0; i < pat->nfa_len; ++i) {
+        free(pat->nfa[i].set);
+    }
+    free(pat->src);
+    free(pat->nfa);
+}
+
+void
+cre_pat_memory_usage(cre_pat* pat, cre_mem* res) {
+    int i;
+    memset(res, 0, sizeof(*res));
+    res->nfa = sizeof(*pat->nfa) * pat->nfa_len + strlen(pat->src) + 1;
+    for (i = 0; i < pat->nfa_len; ++i) {
+        if (pat->nfa[i].set) res->nfa += sizeof(*pat->nfa[i].set) * 256;
+    }
+    res->total = res->nfa;
+}
+
+// add up the total of a memory report
+static void
+cre_mem_total_(cre_mem* m) {
+    m->total = m->nfa + m->classes + m->dfa + m->prefilter + m->scratch;
+}
+
+// add memory report 'x' to 'm'
+static void
+cre_mem_add_(cre_mem* m, const cre_mem* x) {
+    m->nfa += x->nfa;
+    m->classes += x->classes;
+    m->dfa += x->dfa;
+    m->prefilter += x->prefilter;
+    m->scratch += x->scratch;
+    m->total += x->total;
+}
+
+int
+cre_mem_check(const cre_mem* mem, const cre_budget* budget) {
+    if (budget && budget->max_memory && mem->total > budget->max_memory) return cre_BUDGET;
+    return cre_NOMATCH;
+}
+
+// return whether a byte is a word character (i.e. '\w')
+static bool
+cre_isword_(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// return whether a node is a word boundary assertion
+static bool
+cre_node_isb_(const struct cre_node* n) {
+    return n->kind == cre_WORDB || n->kind == cre_NWORDB;
+}
+
+// return whether a node waits for the next byte (i.e. it isn't just passed through)
+static bool
+cre_node_waits_(const struct cre_node* n) {
+    return n->kind == cre_SET || cre_node_isb_(n);
+}
+
+// return whether a word boundary assertion holds, given whether the position is a word
+//   boundary
+static bool
+cre_node_holds_(const struct cre_node* n, bool bound) {
+    return n->kind == cre_WORDB ? bound : !bound;
+}
+
+// return whether a pattern has word boundary assertions
+static bool
+cre_pat_words_(cre_pat* pat) {
+    int i;
+    for (i = 0; i < pat->nfa_len; ++i) {
+        if (cre_node_isb_(&pat->nfa[i])) return true;
+    }
+    return false;
+}
+
+//// IMPL: cre_parse ////
+
+// the grammar accepted by the parser is:
+//   alt := cat ('|' cat)*
+//   cat := rep*
+//   rep := atom ('*' | '+' | '?' | '{n}' | '{n,}' | '{n,m}')*
+//   atom := '(' ['?:'] alt ')' | '[' ['^'] items ']' | '.' | '\' escape | char
+// groups are numbered (from 1) by their '(', unless they are non-capturing '(?:...)'
+// escapes are '\d', '\w', '\s' (and their negations '\D', '\W', '\S'), '\n', '\t',
+//   '\r', '\f', '\v', '\0', '\xHH', or any other character (which is taken literally)
+
+// maximum count allowed in a '{n,m}' repetition, since each repetition copies the NFA
+#define cre_MAX_REPEAT 1000
+
+// NFA fragment built while parsing, which has a start node and a list of open edges
+// the open edges are linked through the edges themselves: each open edge holds
+//   '-3 - next' (where 'next' is the next open edge), or -2 at the end of the list,
+//   so when the pattern is done, the remaining open edges are all -2 (match)
+// edges are referenced as 'node * 2 + (0 for u, 1 for v)', and -1 means no edges
+struct cre_frag_ {
+    int start;
+    int out;
+};
+
+// parser state
+struct cre_parser_ {
+    cre_pat* pat;
+
+    // capacity of 'pat->nfa'
+    int nfa_cap;
+
+    // source being parsed, and current position in it
+    const char* src;
+    const char* s;
+
+    // how many groups deep the parser is
+    int depth;
+
+    // error message (or NULL if none yet)
+    char* err;
+};
+
+// set an error at the current position (only the first error is kept)
+static void
+cre_parse_err_(struct cre_parser_* P, const char* msg) {
+    if (P->err) return;
+    int sz = strlen(msg) + 64;
+    P->err = malloc(sz);
+    snprintf(P->err, sz, "%s (at position %d)", msg, (int)(P->s - P->src));
+}
+
+// add a new node, returning its index
+static int
+cre_parse_node_(struct cre_parser_* P, enum cre_kind kind, int u, int v) {
+    cre_pat* pat = P->pat;
+    if (pat->nfa_len >= cre_MAX_NODES) {
+        // NOTE: the node is still added, and parsing stops soon after (since repetitions
+        //         check how many nodes they will add first, that is only a few more)
+        cre_parse_err_(P, "pattern is too big");
+    }
+    if (pat->nfa_len >= P->nfa_cap) {
+        P->nfa_cap = P->nfa_cap * 2 + 16;
+        pat->nfa = realloc(pat->nfa, sizeof(*pat->nfa) * P->nfa_cap);
+    }
+    int i = pat->nfa_len++;
+    struct cre_node* n = &pat->nfa[i];
+    n->kind = kind;
+    n->u = u;
+    n->v = v;
+    n->set = NULL;
+    n->tag = -1;
+    if (kind == cre_SET) {
+        n->set = calloc(256, sizeof(*n->set));
+    }
+    return i;
+}
+
+// get a pointer to an edge
+static int*
+cre_parse_edge_(struct cre_parser_* P, int e) {
+    struct cre_node* n = &P->pat->nfa[e / 2];
+    return e % 2 == 0 ? &n->u : &n->v;
+}
+
+// concatenate two lists of open edges
+static int
+cre_parse_append_(struct cre_parser_* P, int a, int b) {
+    if (a < 0) return b;
+    if (b < 0) return a;
+    int e = a;
+    int* p;
+    while (*(p = cre_parse_edge_(P, e)) != -2) {
+        e = -3 - *p;
+    }
+    *p = -3 - b;
+    return a;
+}
+
+// link all the open edges in a list to 'to'
+static void
+cre_parse_patch_(struct cre_parser_* P, int a, int to) {
+    while (a >= 0) {
+        int* p = cre_parse_edge_(P, a);
+        int next = *p == -2 ? -1 : -3 - *p;
+        *p = to;
+        a = next;
+    }
+}
+
+// make a fragment matching the empty string
+static struct cre_frag_
+cre_parse_empty_(struct cre_parser_* P) {
+    struct cre_frag_ f;
+    f.start = cre_parse_node_(P, cre_EPS, -2, -1);
+    f.out = f.start * 2;
+    return f;
+}
+
+// make a fragment matching a single character in a set (which is filled in by the caller)
+static struct cre_frag_
+cre_parse_set_(struct cre_parser_* P) {
+    struct cre_frag_ f;
+    f.start = cre_parse_node_(P, cre_SET, -2, -1);
+    f.out = f.start * 2;
+    return f;
+}
+
+// add the characters in a '\d', '\w' or '\s' class (or their negations) to 'set', returning
+//   whether 'c' was such a class
+static bool
+cre_parse_class_(bool* set, char c) {
+    bool neg = c == 'D' || c == 'W' || c == 'S';
+    int i;
+    switch (c) {
+    case 'd': case 'D':
+        for (i = 0; i < 256; ++i) {
+            if ((i >= '0' && i <= '9') != neg) set[i] = true;
+        }
+        return true;
+    case 'w': case 'W':
+        for (i = 0; i < 256; ++i) {
+            bool w = (i >= 'a' && i <= 'z') || (i >= 'A' && i <= 'Z') || (i >= '0' && i <= '9') || i == '_';
+            if (w != neg) set[i] = true;
+        }
+        return true;
+    case 's': case 'S':
+        for (i = 0; i < 256; ++i) {
+            bool w = i == ' ' || i == '\t' || i == '\n' || i == '\r' || i == '\f' || i == '\v';
+            if (w != neg) set[i] = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+// parse the character after a '\' (which has already been consumed), returning
+//   the byte value, or -1 on error
+static int
+cre_parse_esc_(struct cre_parser_* P) {
+    char c = *P->s;
+    if (c == '\0') {
+        cre_parse_err_(P, "trailing '\\'");
+        return -1;
+    }
+    P->s++;
+    switch (c) {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case '0': return '\0';
+    case 'x': {
+        int i, r = 0;
+        for (i = 0; i < 2; ++i) {
+            char h = *P->s;
+            int d = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+            if (d < 0) {
+                cre_parse_err_(P, "expected 2 hex digits after '\\x'");
+                return -1;
+            }
+            r = r * 16 + d;
+            P->s++;
+        }
+        return r;
+    }
+    }
+    return (unsigned char)c;
+}
+
+// parse a '[...]' class (after the '['), filling in 'set'
+static void
+cre_parse_bracket_(struct cre_parser_* P, bool* set) {
+    bool neg = false;
+    if (*P->s == '^') {
+        neg = true;
+        P->s++;
+    }
+    bool first = true;
+    while (first || *P->s != ']') {
+        first = false;
+        if (*P->s == '\0') {
+            cre_parse_err_(P, "missing ']'");
+            return;
+        }
+        int lo;
+        if (*P->s == '\\') {
+            P->s++;
+            if (cre_parse_class_(set, *P->s)) {
+                P->s++;
+                continue;
+            }
+            if ((lo = cre_parse_esc_(P)) < 0) return;
+        } else {
+            lo = (unsigned char)*P->s++;
+        }
+        int hi = lo;
+        if (P->s[0] == '-' && P->s[1] != ']' && P->s[1] != '\0') {
+            P->s++;
+            if (*P->s == '\\') {
+                P->s++;
+                if ((hi = cre_parse_esc_(P)) < 0) return;
+            } else {
+                hi = (unsigned char)*P->s++;
+            }
+            if (hi < lo) {
+                cre_parse_err_(P, "invalid range in '[...]'");
+                return;
+            }
+        }
+        int i;
+        for (i = lo; i <= hi; ++i) {
+            set[i] = true;
+        }
+    }
+    P->s++;
+    if (neg) {
+        int i;
+        for (i = 0; i < 256; ++i) {
+            set[i] = !set[i];
+        }
+    }
+}
+
+static struct cre_frag_
+cre_parse_alt_(struct cre_parser_* P);
+
+static struct cre_frag_
+cre_parse_atom_(struct cre_parser_* P) {
+    struct cre_frag_ f;
+    char c = *P->s;
+    if (c == '(') {
+        P->s++;
+        int g = -1;
+        if (P->s[0] == '?' && P->s[1] == ':') {
+            P->s += 2;
+        } else {
+            g = ++P->pat->ngroups;
+        }
+        if (P->depth >= cre_MAX_DEPTH) {
+            // NOTE: groups are parsed recursively, so this keeps the C stack bounded
+            cre_parse_err_(P, "groups are nested too deeply");
+            return cre_parse_empty_(P);
+        }
+        P->depth++;
+        f = cre_parse_alt_(P);
+        P->depth--;
+        if (*P->s != ')') {
+            cre_parse_err_(P, "missing ')'");
+        } else {
+            P->s++;
+        }
+        if (g >= 0) {
+            // surround the group with tags for its start and end
+            int a = cre_parse_node_(P, cre_TAG, f.start, -1);
+            int b = cre_parse_node_(P, cre_TAG, -2, -1);
+            P->pat->nfa[a].tag = 2 * g;
+            P->pat->nfa[b].tag = 2 * g + 1;
+            cre_parse_patch_(P, f.out, b);
+            f.start = a;
+            f.out = b * 2;
+        }
+    } else if (c == '[') {
+        P->s++;
+        f = cre_parse_set_(P);
+        cre_parse_bracket_(P, P->pat->nfa[f.start].set);
+    } else if (c == '.') {
+        P->s++;
+        f = cre_parse_set_(P);
+        int i;
+        for (i = 0; i < 256; ++i) {
+            P->pat->nfa[f.start].set[i] = i != '\n';
+        }
+    } else if (c == '*' || c == '+' || c == '?' || c == '{') {
+        cre_parse_err_(P, "nothing to repeat");
+        f = cre_parse_empty_(P);
+    } else if (c == '\\' && (P->s[1] == 'b' || P->s[1] == 'B')) {
+        P->s += 2;
+        f.start = cre_parse_node_(P, P->s[-1] == 'b' ? cre_WORDB : cre_NWORDB, -2, -1);
+        f.out = f.start * 2;
+    } else if (c == '\\') {
+        P->s++;
+        f = cre_parse_set_(P);
+        bool* set = P->pat->nfa[f.start].set;
+        if (cre_parse_class_(set, *P->s)) {
+            P->s++;
+        } else {
+            int b = cre_parse_esc_(P);
+            if (b >= 0) set[b] = true;
+        }
+    } else {
+        P->s++;
+        f = cre_parse_set_(P);
+        P->pat->nfa[f.start].set[(unsigned char)c] = true;
+    }
+    return f;
+}
+
+// copy the nodes 'lo' through 'hi' (which make up fragment 'f') to the end of the NFA
+static struct cre_frag_
+cre_parse_copy_(struct cre_parser_* P, struct cre_frag_ f, int lo, int hi) {
+    int d = P->pat->nfa_len - lo;
+    int i;
+    for (i = lo; i < hi; ++i) {
+        struct cre_node n = P->pat->nfa[i];
+        int j = cre_parse_node_(P, n.kind, n.u, n.v);
+        struct cre_node* m = &P->pat->nfa[j];
+        if (n.kind == cre_SET) {
+            memcpy(m->set, n.set, sizeof(*m->set) * 256);
+        }
+        m->tag = n.tag;
+        // shift node references and open edge references into the copy
+        m->u = m->u >= 0 ? m->u + d : m->u <= -3 ? -3 - (-3 - m->u + 2 * d) : m->u;
+        m->v = m->v >= 0 ? m->v + d : m->v <= -3 ? -3 - (-3 - m->v + 2 * d) : m->v;
+    }
+    struct cre_frag_ g;
+    g.start = f.start + d;
+    g.out = f.out < 0 ? f.out : f.out + 2 * d;
+    return g;
+}
+
+// parse a number in a '{n,m}'
+static int
+cre_parse_num_(struct cre_parser_* P) {
+    if (*P->s < '0' || *P->s > '9') {
+        cre_parse_err_(P, "expected a number in '{...}'");
+        return -1;
+    }
+    int r = 0;
+    while (*P->s >= '0' && *P->s <= '9') {
+        r = r * 10 + (*P->s++ - '0');
+        if (r > cre_MAX_REPEAT) {
+            cre_parse_err_(P, "repetition count is too large");
+            return -1;
+        }
+    }
+    return r;
+}
+
+static struct cre_frag_
+cre_parse_rep_(struct cre_parser_* P) {
+    int lo = P->pat->nfa_len;
+    struct cre_frag_ f = cre_parse_atom_(P);
+    while (!P->err) {
+        char c = *P->s;
+        if (c == '*') {
+            // greedy: prefer the body (u) over leaving (v)
+            P->s++;
+            int e = cre_parse_node_(P, cre_EPS, f.start, -2);
+            cre_parse_patch_(P, f.out, e);
+            f.start = e;
+            f.out = e * 2 + 1;
+        } else if (c == '+') {
+            P->s++;
+            int e = cre_parse_node_(P, cre_EPS, f.start, -2);
+            cre_parse_patch_(P, f.out, e);
+            f.out = e * 2 + 1;
+        } else if (c == '?') {
+            P->s++;
+            int e = cre_parse_node_(P, cre_EPS, f.start, -2);
+            f.start = e;
+            f.out = cre_parse_append_(P, f.out, e * 2 + 1);
+        } else if (c == '{') {
+            P->s++;
+            int n = cre_parse_num_(P), m = n;
+            if (*P->s == ',') {
+                P->s++;
+                m = *P->s == '}' ? -1 : cre_parse_num_(P);
+            }
+            if (P->err) break;
+            if (*P->s != '}') {
+                cre_parse_err_(P, "missing '}'");
+                break;
+            }
+            P->s++;
+            if (m >= 0 && m < n) {
+                cre_parse_err_(P, "invalid range in '{n,m}'");
+                break;
+            }
+
+            // make all the copies first, since linking modifies the original
+            int hi = P->pat->nfa_len;
+            int nc = m < 0 ? (n > 0 ? n : 1) : m, i;
+            if ((size_t)nc * (hi - lo + 2) + hi > cre_MAX_NODES) {
+                // NOTE: nested repetitions multiply, so this is checked before copying
+                cre_parse_err_(P, "pattern is too big");
+                break;
+            }
+            struct cre_frag_* cs = malloc(sizeof(*cs) * (nc > 0 ? nc : 1));
+            if (nc > 0) cs[0] = f;
+            for (i = 1; i < nc; ++i) {
+                cs[i] = cre_parse_copy_(P, f, lo, hi);
+            }
+
+            // required copies, then optional copies (or a loop, if unbounded)
+            struct cre_frag_ r = cre_parse_empty_(P);
+            for (i = 0; i < nc; ++i) {
+                struct cre_frag_ g = cs[i];
+                if (i >= n || (m < 0 && i == nc - 1)) {
+                    int e = cre_parse_node_(P, cre_EPS, g.start, -2);
+                    if (m < 0) {
+                        // last copy loops (as 'g+' if required, 'g*' if not)
+                        cre_parse_patch_(P, g.out, e);
+                        if (i >= n) g.start = e;
+                        g.out = e * 2 + 1;
+                    } else {
+                        g.start = e;
+                        g.out = cre_parse_append_(P, g.out, e * 2 + 1);
+                    }
+                }
+                cre_parse_patch_(P, r.out, g.start);
+                r.out = g.out;
+            }
+            free(cs);
+            f = r;
+        } else {
+            break;
+        }
+    }
+    return f;
+}
+
+// whether the parser is at the end of a concatenation
+#define cre_parse_catend_(P) (*(P)->s == '\0' || *(P)->s == '|' || *(P)->s == ')')
+
+static struct cre_frag_
+cre_parse_cat_(struct cre_parser_* P) {
+    if (cre_parse_catend_(P)) {
+        return cre_parse_empty_(P);
+    }
+    struct cre_frag_ f = cre_parse_rep_(P);
+    while (!P->err && !cre_parse_catend_(P)) {
+        struct cre_frag_ g = cre_parse_rep_(P);
+        cre_parse_patch_(P, f.out, g.start);
+        f.out = g.out;
+    }
+    return f;
+}
+
+static struct cre_frag_
+cre_parse_alt_(struct cre_parser_* P) {
+    struct cre_frag_ f = cre_parse_cat_(P);
+    while (!P->err && *P->s == '|') {
+        P->s++;
+        struct cre_frag_ g = cre_parse_cat_(P);
+        // prefer the left side (u) over the right side (v)
+        int e = cre_parse_node_(P, cre_EPS, f.start, g.start);
+        f.start = e;
+        f.out = cre_parse_append_(P, f.out, g.out);
+    }
+    return f;
+}
+
+// parse 'src' into 'pat->nfa', returning the start node (or -1, and setting '*err')
+static int
+cre_parse_(cre_pat* pat, const char* src, char** err) {
+    struct cre_parser_ P;
+    P.pat = pat;
+    P.nfa_cap = 0;
+    P.src = P.s = src;
+    P.depth = 0;
+    P.err = NULL;
+
+    struct cre_frag_ f = cre_parse_alt_(&P);
+    if (!P.err && *P.s == ')') {
+        cre_parse_err_(&P, "unmatched ')'");
+    }
+    if (P.err) {
+        *err = P.err;
+        return -1;
+    }
+    // the remaining open edges become the match
+    // NOTE: they are chained through each other, so they must be rewritten to exactly -2
+    cre_parse_patch_(&P, f.out, -2);
+    return f.start;
+}
+
+//// IMPL: cre_pat_analyze ////
+
+int
+cre_pat_classes(cre_pat* pat, uint8_t* cls) {
+    // start with every byte in one class, then split the classes by each set
+    // NOTE: word boundaries depend on whether a byte is a word character, so with them,
+    //         that splits the classes too (as the last set)
+    int ncls = 1, i, j;
+    bool words = cre_pat_words_(pat);
+    memset(cls, 0, 256);
+    int map[512];
+    for (i = 0; i <= pat->nfa_len; ++i) {
+        struct cre_node* n = i < pat->nfa_len ? &pat->nfa[i] : NULL;
+        if (n ? n->kind != cre_SET : !words) continue;
+        for (j = 0; j < 512; ++j) {
+            map[j] = -1;
+        }
+        ncls = 0;
+        for (j = 0; j < 256; ++j) {
+            int k = cls[j] * 2 + ((n ? n->set[j] : cre_isword_(j)) ? 1 : 0);
+            if (map[k] < 0) map[k] = ncls++;
+            cls[j] = map[k];
+        }
+    }
+    return ncls;
+}
+
+// scratch space for walking the NFA
+struct cre_walk_ {
+    cre_pat* pat;
+
+    // which nodes have been visited (all false in between walks)
+    bool* mark;
+
+    // stack of nodes to visit (2 * nfa_len + 1)
+    int* stack;
+
+    // list of nodes visited in the current walk (nfa_len)
+    int* vis;
+
+    // if 'pats' is given, the patterns whose match is reached are added to it (skipping
+    //   ones that are already in 'pmark')
+    int* pats;
+    bool* pmark;
+    int npats;
+
+    // whether word boundary assertions stop the walk (like SET nodes), instead of being
+    //   passed through like epsilon nodes
+    // NOTE: passing through them is fine for analysis, since it only allows more matches
+    bool words;
+
+    // number of nodes visited by all walks so far
+    size_t nsteps;
+
+};
+
+static void
+cre_walk_init_(struct cre_walk_* W, cre_pat* pat) {
+    W->pat = pat;
+    W->mark = calloc(pat->nfa_len + 1, sizeof(*W->mark));
+    W->stack = malloc(sizeof(*W->stack) * (2 * pat->nfa_len + 1));
+    W->vis = malloc(sizeof(*W->vis) * (pat->nfa_len + 1));
+    W->pats = NULL;
+    W->pmark = NULL;
+    W->npats = 0;
+    W->words = false;
+    W->nsteps = 0;
+}
+
+static void
+cre_walk_free_(struct cre_walk_* W) {
+    free(W->mark);
+    free(W->stack);
+    free(W->vis);
+}
+
+// find the SET nodes (and word boundaries, if 'W->words') reachable from 'u' and 'v'
+//   through epsilon nodes, writing them to 'out' (if non-NULL) and returning how many
+//   there are
+// if 'acc' is given, it is set to whether the match/accept can be reached as well, and
+//   if 'dup' is given, it is set to whether any node can be reached in more than one way
+static int
+cre_walk_closure_(struct cre_walk_* W, int u, int v, int* out, bool* acc, bool* dup) {
+    int sp = 0, nout = 0, nvis = 0, i, j;
+    W->stack[sp++] = v;
+    W->stack[sp++] = u;
+    while (sp > 0) {
+        i = W->stack[--sp];
+        if (i == -1) continue;
+        if (i <= -2) {
+            if (acc) *acc = true;
+            if (W->pats && !W->pmark[-2 - i]) {
+                W->pmark[-2 - i] = true;
+                W->pats[W->npats++] = -2 - i;
+            }
+            continue;
+        }
+        if (W->mark[i]) {
+            if (dup) *dup = true;
+            continue;
+        }
+        W->mark[i] = true;
+        W->vis[nvis++] = i;
+        struct cre_node* n = &W->pat->nfa[i];
+        if (n->kind != cre_SET && !(W->words && cre_node_isb_(n))) {
+            W->stack[sp++] = n->v;
+            W->stack[sp++] = n->u;
+        } else {
+            if (out) out[nout] = i;
+            nout++;
+        }
+    }
+    for (j = 0; j < nvis; ++j) {
+        W->mark[W->vis[j]] = false;
+    }
+    W->nsteps += nvis;
+    return nout;
+}
+
+// return the single byte that a SET node matches, or -1 if it matches zero or several
+static int
+cre_node_byte_(struct cre_node* n) {
+    int i, r = -1;
+    for (i = 0; i < 256; ++i) {
+        if (n->set[i]) {
+            if (r >= 0) return -1;
+            r = i;
+        }
+    }
+    return r;
+}
+
+// return whether the match/accept can be reached from the start without going through 'x'
+static bool
+cre_walk_avoids_(struct cre_walk_* W, int x) {
+    cre_pat* pat = W->pat;
+    int sp = 0, nvis = 0, i, j;
+    bool res = false;
+    W->stack[sp++] = pat->nfa_start;
+    while (sp > 0 && !res) {
+        i = W->stack[--sp];
+        if (i == -1 || i == x) continue;
+        if (i <= -2) {
+            res = true;
+            continue;
+        }
+        if (W->mark[i]) continue;
+        W->mark[i] = true;
+        W->vis[nvis++] = i;
+        W->stack[sp++] = pat->nfa[i].v;
+        W->stack[sp++] = pat->nfa[i].u;
+    }
+    for (j = 0; j < nvis; ++j) {
+        W->mark[W->vis[j]] = false;
+    }
+    return res;
+}
+
+// compute the minimum and maximum number of bytes a match can have (-1 for unbounded)
+static void
+cre_pat_lens_(cre_pat* pat, int* minlen, int* maxlen) {
+    int N = pat->nfa_len, i, j;
+
+    // minimum: 0-1 BFS, where leaving a SET node costs 1
+    int* dist = malloc(sizeof(*dist) * N);
+    int* dq = malloc(sizeof(*dq) * (4 * N + 2));
+    int head = 2 * N + 1, tail = 2 * N + 1;
+    for (i = 0; i < N; ++i) {
+        dist[i] = INT32_MAX;
+    }
+    *minlen = -1;
+    dist[pat->nfa_start] = 0;
+    dq[tail++] = pat->nfa_start;
+    while (head < tail) {
+        i = dq[head++];
+        struct cre_node* n = &pat->nfa[i];
+        int w = n->kind == cre_SET ? 1 : 0;
+        int e[2] = { n->u, n->v };
+        for (j = 0; j < 2; ++j) {
+            int d = dist[i] + w;
+            if (e[j] <= -2) {
+                if (*minlen < 0 || d < *minlen) *minlen = d;
+            } else if (e[j] >= 0 && d < dist[e[j]]) {
+                dist[e[j]] = d;
+                if (w == 0) dq[--head] = e[j];
+                else dq[tail++] = e[j];
+            }
+        }
+    }
+    free(dq);
+
+    // maximum: find the strongly connected components (Tarjan's algorithm, without
+    //   recursion), which are produced in reverse topological order. a component with
+    //   a cycle through a SET node means matches can be arbitrarily long
+    int* idx = malloc(sizeof(*idx) * N);
+    int* low = malloc(sizeof(*low) * N);
+    int* comp = malloc(sizeof(*comp) * N);
+    int* stk = malloc(sizeof(*stk) * N);
+    int* call = malloc(sizeof(*call) * N);
+    int* edge = malloc(sizeof(*edge) * N);
+    // longest path (in bytes) from each component to the match, or -1 for unbounded
+    int* longest = malloc(sizeof(*longest) * N);
+    for (i = 0; i < N; ++i) {
+        idx[i] = -1;
+        comp[i] = -1;
+    }
+    int nidx = 0, sp = 0, cp = 0, ncomp = 0;
+    *maxlen = 0;
+    call[cp] = pat->nfa_start;
+    edge[cp++] = 0;
+    idx[pat->nfa_start] = low[pat->nfa_start] = nidx++;
+    stk[sp++] = pat->nfa_start;
+    while (cp > 0) {
+        i = call[cp - 1];
+        struct cre_node* n = &pat->nfa[i];
+        if (edge[cp - 1] < 2) {
+            int t = edge[cp - 1]++ == 0 ? n->u : n->v;
+            if (t < 0) continue;
+            if (idx[t] < 0) {
+                idx[t] = low[t] = nidx++;
+                stk[sp++] = t;
+                call[cp] = t;
+                edge[cp++] = 0;
+            } else if (comp[t] < 0 && idx[t] < low[i]) {
+                low[i] = idx[t];
+            }
+            continue;
+        }
+        // done with 'i'
+        cp--;
+        if (cp > 0 && low[i] < low[call[cp - 1]]) {
+            low[call[cp - 1]] = low[i];
+        }
+        if (low[i] != idx[i]) continue;
+
+        // 'i' is the root of a component, so pop it off
+        int c = ncomp++, size = 0, w = 0, best = 0;
+        bool cyc = false;
+        do {
+            j = stk[--sp];
+            comp[j] = c;
+            size++;
+            if (pat->nfa[j].kind == cre_SET) w++;
+        } while (j != i);
+        // now, go over the edges leaving the component (whose components are all done)
+        for (j = sp; j < sp + size; ++j) {
+            struct cre_node* m = &pat->nfa[stk[j]];
+            int e[2] = { m->u, m->v }, k;
+            for (k = 0; k < 2; ++k) {
+                if (e[k] < 0) continue;
+                if (comp[e[k]] == c) {
+                    cyc = true;
+                } else if (best >= 0) {
+                    int l = longest[comp[e[k]]];
+                    best = l < 0 ? -1 : (l > best ? l : best);
+                }
+            }
+        }
+        longest[c] = (cyc && w > 0) || best < 0 ? -1 : best + w;
+    }
+    *maxlen = longest[comp[pat->nfa_start]];
+
+    free(dist);
+    free(idx);
+    free(low);
+    free(comp);
+    free(stk);
+    free(call);
+    free(edge);
+    free(longest);
+}
+
+// explore the (unanchored) DFA that subset construction would produce for a pattern,
+//   returning how many states it has, or -1 if it has more than 'limit' (or exploring them
+//   takes more than 'cre_ANALYZE_STEPS')
+static int
+cre_pat_probe_(cre_pat* pat, const uint8_t* cls, int ncls, int limit) {
+    int N = pat->nfa_len, i, j;
+    // one bit per node, plus one for whether the state is accepting, and one for whether
+    //   the last byte was a word character
+    // NOTE: the states are grown as they are found, since the steps usually run out long
+    //         before 'limit' states of a big NFA would
+    int W = (N + 2 + 63) / 64, scap = 16;
+    uint64_t* sets = malloc(sizeof(*sets) * scap * W);
+    size_t steps = 0;
+    int tcap = 16;
+    while (tcap < 2 * limit) tcap *= 2;
+    int* tab = malloc(sizeof(*tab) * tcap);
+    for (i = 0; i < tcap; ++i) {
+        tab[i] = -1;
+    }
+
+    // a representative byte from each class
+    int rep[256];
+    for (i = 255; i >= 0; --i) {
+        rep[cls[i]] = i;
+    }
+
+    cre_sim sim;
+    cre_sim_init(&sim, pat);
+
+    int nstates = 0, cur;
+    bool acc = false;
+    for (cur = -1; cur < nstates; ++cur) {
+        for (j = 0; j < (cur < 0 ? 1 : ncls); ++j) {
+            // each step goes over every node (loading and storing the state), and the ones
+            //   the simulator visits
+            steps += N + sim.nsteps;
+            sim.nsteps = 0;
+            if (steps > cre_ANALYZE_STEPS) {
+                nstates = -1;
+                goto done;
+            }
+            if (cur >= 0) {
+                // load the current state into the simulator and step it
+                uint64_t* s = &sets[(size_t)cur * W];
+                for (i = 0; i < N; ++i) {
+                    sim.in[i] = (s[i / 64] >> (i % 64)) & 1;
+                }
+                sim.word = (s[(N + 1) / 64] >> ((N + 1) % 64)) & 1;
+                acc = cre_sim_feedc(&sim, rep[j]);
+            }
+            // every position also starts a new match attempt
+            cre_sim_feedz(&sim, cre_START);
+
+            // now, make the new state and look it up
+            if (nstates >= scap) {
+                scap *= 2;
+                sets = realloc(sets, sizeof(*sets) * scap * W);
+            }
+            uint64_t* t = &sets[(size_t)nstates * W];
+            memset(t, 0, sizeof(*t) * W);
+            uint64_t h = acc ? 1 : 0;
+            for (i = 0; i < N; ++i) {
+                if (sim.in[i] && cre_node_waits_(&pat->nfa[i])) {
+                    t[i / 64] |= (uint64_t)1 << (i % 64);
+                    h = (h ^ i) * 0x100000001b3ULL;
+                }
+            }
+            if (acc) t[N / 64] |= (uint64_t)1 << (N % 64);
+            if (sim.word) {
+                t[(N + 1) / 64] |= (uint64_t)1 << ((N + 1) % 64);
+                h = (h ^ (N + 1)) * 0x100000001b3ULL;
+            }
+            int k = h & (tcap - 1);
+            while (tab[k] >= 0 && memcmp(&sets[(size_t)tab[k] * W], t, sizeof(*t) * W) != 0) {
+                k = (k + 1) & (tcap - 1);
+            }
+            if (tab[k] < 0) {
+                if (nstates >= limit) {
+                    nstates = -1;
+                    goto done;
+                }
+                tab[k] = nstates++;
+            }
+        }
+    }
+    done:
+
+    cre_sim_free(&sim);
+    free(sets);
+    free(tab);
+    return nstates;
+}
+
+static bool
+cre_bsim_ok_(cre_pat* pat);
+
+const char*
+cre_engine_name(enum cre_engine engine) {
+    switch (engine) {
+    case cre_ENGINE_SIM: return "sim";
+    case cre_ENGINE_TDFA: return "tdfa";
+    case cre_ENGINE_DFA: return "dfa";
+    case cre_ENGINE_BSIM: return "bsim";
+    }
+    return "?";
+}
+
+void
+cre_pat_analyze(cre_pat* pat, cre_analysis* res) {
+    int N = pat->nfa_len, i, j;
+    memset(res, 0, sizeof(*res));
+
+    // size of the NFA
+    res->nfa_len = N;
+    res->nfa_bytes = sizeof(*pat->nfa) * N;
+    for (i = 0; i < N; ++i) {
+        if (pat->nfa[i].kind == cre_SET) res->nfa_bytes += sizeof(*pat->nfa[i].set) * 256;
+    }
+
+    uint8_t cls[256];
+    res->nclasses = cre_pat_classes(pat, cls);
+
+    // see how big a DFA would get
+    res->dfa_states = cre_pat_probe_(pat, cls, res->nclasses, cre_ANALYZE_STATES);
+    res->dfa_explodes = res->dfa_states < 0;
+
+    cre_pat_lens_(pat, &res->min_len, &res->max_len);
+
+    struct cre_walk_ W;
+    cre_walk_init_(&W, pat);
+    int* out = malloc(sizeof(*out) * (N + 1));
+    bool acc, dup;
+    int nout;
+
+    // literal prefix: while there's only one way to go, and it matches only one byte
+    acc = false;
+    nout = cre_walk_closure_(&W, pat->nfa_start, -1, out, &acc, NULL);
+    while (nout == 1 && !acc && res->prefix_len < cre_MAX_FACTOR_LEN) {
+        struct cre_node* n = &pat->nfa[out[0]];
+        int b = cre_node_byte_(n);
+        if (b < 0) break;
+        res->prefix[res->prefix_len++] = b;
+        nout = cre_walk_closure_(&W, n->u, n->v, out, &acc, NULL);
+    }
+
+    // one-pass: from the start, and after each SET node, all the SET nodes that
+    //   can come next must match disjoint bytes, and be reachable in only one way
+    res->onepass = true;
+    W.nsteps = 0;
+    for (i = -1; i < N && res->onepass; ++i) {
+        if (W.nsteps > cre_ANALYZE_STEPS) {
+            res->onepass = false;
+            break;
+        }
+        dup = false;
+        if (i < 0) {
+            nout = cre_walk_closure_(&W, pat->nfa_start, -1, out, NULL, &dup);
+        } else if (pat->nfa[i].kind == cre_SET) {
+            nout = cre_walk_closure_(&W, pat->nfa[i].u, pat->nfa[i].v, out, NULL, &dup);
+        } else {
+            continue;
+        }
+        if (dup) res->onepass = false;
+        bool seen[256] = { false };
+        for (j = 0; j < nout && res->onepass; ++j) {
+            int k;
+            for (k = 0; k < 256; ++k) {
+                if (pat->nfa[out[j]].set[k]) {
+                    if (seen[k]) res->onepass = false;
+                    seen[k] = true;
+                }
+            }
+            W.nsteps += 256 / 64;
+        }
+    }
+
+    // literal factors: chains of single-byte SET nodes that every match goes through,
+    //   where each one can only be followed by the next
+    if (N <= cre_ANALYZE_FACTOR_NODES) {
+        // whether each node is a required single-byte node, and what must follow it
+        int* next = malloc(sizeof(*next) * N);
+        bool* head = malloc(sizeof(*head) * N);
+        for (i = 0; i < N; ++i) {
+            next[i] = -2;
+            head[i] = false;
+            if (pat->nfa[i].kind == cre_SET && cre_node_byte_(&pat->nfa[i]) >= 0 && !cre_walk_avoids_(&W, i)) {
+                next[i] = -1;
+                head[i] = true;
+            }
+        }
+        for (i = 0; i < N; ++i) {
+            if (next[i] != -1) continue;
+            acc = false;
+            nout = cre_walk_closure_(&W, pat->nfa[i].u, pat->nfa[i].v, out, &acc, NULL);
+            if (nout == 1 && !acc && next[out[0]] != -2 && out[0] != i) {
+                next[i] = out[0];
+                head[out[0]] = false;
+            }
+        }
+        for (i = 0; i < N; ++i) {
+            if (!head[i]) continue;
+            char lit[cre_MAX_FACTOR_LEN];
+            int len = 0;
+            for (j = i; j >= 0 && len < cre_MAX_FACTOR_LEN; j = next[j]) {
+                lit[len++] = cre_node_byte_(&pat->nfa[j]);
+            }
+            // keep the longest factors, sorted by length
+            int k = res->nfactors;
+            if (k < cre_MAX_FACTORS) {
+                res->nfactors++;
+            } else if (res->factors_len[k - 1] < len) {
+                k--;
+            } else {
+                continue;
+            }
+            while (k > 0 && res->factors_len[k - 1] < len) {
+                memcpy(res->factors[k], res->factors[k - 1], res->factors_len[k - 1]);
+                res->factors_len[k] = res->factors_len[k - 1];
+                k--;
+            }
+            memcpy(res->factors[k], lit, len);
+            res->factors_len[k] = len;
+        }
+        free(next);
+        free(head);
+    }
+
+    free(out);
+    cre_walk_free_(&W);
+
+    // pick an engine, and figure out its costs
+    res->engine = cre_ENGINE_SIM;
+    res->steps_per_byte = N;
+    res->engine_bytes = sizeof(cre_sim) + 2 * sizeof(bool) * N + sizeof(int) * (2 * N + 1);
+
+    // captures are extracted with a TDFA if it isn't too big
+    // NOTE: building each state takes about a step per NFA node for each class, so it gets
+    //         as many states as fit in the steps
+    cre_tdfa d;
+    cre_budget tb;
+    memset(&tb, 0, sizeof(tb));
+    size_t ts = cre_ANALYZE_STEPS / ((size_t)(N > 0 ? N : 1) * res->nclasses);
+    tb.max_states = ts < 1 ? 1 : ts > cre_TDFA_MAX_STATES ? cre_TDFA_MAX_STATES : (int)ts;
+    if (pat->ngroups > 0 && cre_tdfa_init(&d, pat, &tb) == 0) {
+        int t, nt = d.nstates * d.ncls;
+        res->engine = cre_ENGINE_TDFA;
+        res->steps_per_byte = 1;
+        for (t = 0; t < nt; ++t) {
+            if (1 + d.opsoff[t + 1] - d.opsoff[t] > res->steps_per_byte) {
+                res->steps_per_byte = 1 + d.opsoff[t + 1] - d.opsoff[t];
+            }
+        }
+        res->engine_bytes = sizeof(d) + (sizeof(*d.trans) + sizeof(*d.opsoff)) * nt + 2 * sizeof(*d.ops) * d.opsoff[nt]
+                          + (sizeof(*d.acc) + sizeof(*d.live)) * d.nstates + 2 * sizeof(*d.regs) * d.nregs;
+        cre_tdfa_free(&d);
+    }
+
+    // otherwise, the DFA is used if it doesn't explode
+    if (pat->ngroups == 0 && !res->dfa_explodes) {
+        res->engine = cre_ENGINE_DFA;
+        res->steps_per_byte = 1;
+        res->engine_bytes = sizeof(cre_dfa) + sizeof(int) * (size_t)res->dfa_states * (res->nclasses + 4);
+    }
+
+    // and if it does, the bitset simulator is used if the pattern allows it
+    cre_bsim b;
+    if (pat->ngroups == 0 && res->dfa_explodes && cre_bsim_ok_(pat)) {
+        cre_bsim_init(&b, pat);
+        cre_mem m;
+        cre_bsim_memory_usage(&b, &m);
+        res->engine = cre_ENGINE_BSIM;
+        // NOTE: the worst case is when it is in every SET node, and they all match
+        res->steps_per_byte = b.nwords;
+        for (i = 0; i < N; ++i) {
+            if (b.row[i] >= 0) res->steps_per_byte += b.hi[b.row[i]] - b.lo[b.row[i]];
+        }
+        res->engine_bytes = sizeof(b) + m.total;
+        cre_bsim_free(&b);
+    }
+}
+
+
+//// IMPL: cre_sim ////
+
+// how many bytes the bulk searching functions feed between checking the more
+//   expensive budget limits (steps, deadline and cancellation)
+#define cre_CHECK_EVERY 256
+
+void
+cre_sim_init(cre_sim* sim, cre_pat* pat) {
+    sim->pat = pat;
+    sim->in = malloc(sizeof(*sim->in) * pat->nfa_len);
+    sim->lastin = malloc(sizeof(*sim->lastin) * pat->nfa_len);
+    // each node is expanded at most once per step, pushing at most 2 entries
+    sim->stack = malloc(sizeof(*sim->stack) * (2 * pat->nfa_len + 1));
+    sim->words = cre_pat_words_(pat);
+
+    // start off by resetting it
+    cre_sim_reset(sim);
+}
+
+void
+cre_sim_free(cre_sim* sim) {
+    free(sim->in);
+    free(sim->lastin);
+    free(sim->stack);
+}
+
+// return how many bytes a simulator for 'pat' allocates (see 'cre_sim_init')
+static size_t
+cre_sim_bytes_(cre_pat* pat) {
+    return 2 * sizeof(bool) * pat->nfa_len + sizeof(int) * (2 * pat->nfa_len + 1);
+}
+
+void
+cre_sim_memory_usage(cre_sim* sim, cre_mem* res) {
+    memset(res, 0, sizeof(*res));
+    res->scratch = cre_sim_bytes_(sim->pat);
+    cre_mem_total_(res);
+}
+
+static bool
+cre_sim_add_(cre_sim* sim, int i);
+
+void
+cre_sim_reset(cre_sim* sim) {
+    // initialize everything to false
+    int i;
+    for (i = 0; i < sim->pat->nfa_len; i++) {
+        sim->in[i] = sim->lastin[i] = false;
+    }
+    sim->nbytes = sim->nsteps = 0;
+    sim->word = false;
+    sim->bound = -1;
+    // then, add the start state (and whatever it transitions to)
+    sim->null = cre_sim_add_(sim, sim->pat->nfa_start);
+}
+
+// add a state (and everything reachable from it through epsilon nodes), returning
+//   whether a match/accept was reached
+// NOTE: this uses an explicit stack instead of recursion, so deeply nested patterns
+//         can't blow up the C stack, and each node is only visited once (which also
+//         makes epsilon cycles, i.e. from 'a**', terminate)
+static bool
+cre_sim_add_(cre_sim* sim, int i) {
+    bool res = false;
+    int sp = 0;
+    sim->stack[sp++] = i;
+
+    while (sp > 0) {
+        i = sim->stack[--sp];
+        if (i == -1) {
+            // empty/nothing further
+            continue;
+        } else if (i <= -2) {
+            // match/accept
+            res = true;
+            continue;
+        }
+
+        // should be in range
+        assert(i >= 0 && i < sim->pat->nfa_len);
+        if (sim->in[i]) {
+            // already visited during this step
+            continue;
+        }
+        sim->in[i] = true;
+        sim->nsteps++;
+
+        struct cre_node* n = &sim->pat->nfa[i];
+        if (cre_node_isb_(n)) {
+            // word boundaries wait until it is known whether this position is one
+            if (sim->bound >= 0 && cre_node_holds_(n, sim->bound)) {
+                sim->stack[sp++] = n->v;
+                sim->stack[sp++] = n->u;
+            }
+        } else if (n->kind != cre_SET) {
+            // on epsilon (and tag) nodes, simulate an instant transition to those states
+            // NOTE: the simulator never matches a character on an epsilon node, it is
+            //         only marked so that it isn't visited again
+            sim->stack[sp++] = n->v;
+            sim->stack[sp++] = n->u;
+        }
+    }
+
+    return res;
+}
+
+// return whether a match/accept is reachable from the word boundaries that hold at the
+//   current position (given 'sim->bound'), even through nodes that are already active,
+//   which 'cre_sim_add_' skips (so that a match decided by the next byte is reported even
+//   if one also ended right before it)
+// NOTE: this uses 'lastin' to mark visited nodes, since it is only scratch space here
+static bool
+cre_sim_reach_(cre_sim* sim) {
+    int N = sim->pat->nfa_len, sp = 0, i, j;
+    memset(sim->lastin, 0, sizeof(*sim->lastin) * N);
+    for (i = 0; i < N; i++) {
+        if (!sim->in[i] || sim->lastin[i] || !cre_node_isb_(&sim->pat->nfa[i])) continue;
+        sim->stack[sp++] = i;
+        while (sp > 0) {
+            j = sim->stack[--sp];
+            if (j == -1) {
+                continue;
+            } else if (j <= -2) {
+                return true;
+            } else if (sim->lastin[j]) {
+                continue;
+            }
+            sim->lastin[j] = true;
+            struct cre_node* n = &sim->pat->nfa[j];
+            if (n->kind == cre_SET || (cre_node_isb_(n) && !cre_node_holds_(n, sim->bound))) continue;
+            sim->stack[sp++] = n->v;
+            sim->stack[sp++] = n->u;
+        }
+    }
+    return false;
+}
+
+// decide the word boundaries waiting at the current position, given whether the next byte
+//   is a word character, returning whether a match/accept was reached
+static bool
+cre_sim_bound_(cre_sim* sim, bool word) {
+    int i;
+    sim->bound = sim->word != word;
+    bool res = cre_sim_reach_(sim);
+    for (i = 0; i < sim->pat->nfa_len; i++) {
+        struct cre_node* n = &sim->pat->nfa[i];
+        if (sim->in[i] && cre_node_isb_(n) && cre_node_holds_(n, sim->bound)) {
+            cre_sim_add_(sim, n->u);
+            cre_sim_add_(sim, n->v);
+        }
+    }
+    sim->bound = -1;
+    return res;
+}
+
+bool
+cre_sim_feedc(cre_sim* sim, char c) {
+    // first, a match may end just before 'c', at a word boundary
+    bool res = false;
+    if (sim->words) {
+        if (cre_sim_bound_(sim, cre_isword_(c))) res = true;
+        sim->word = cre_isword_(c);
+    }
+
+    // swap buffers, since we're about to overwrite them
+    bool* tmp = sim->in;
+    sim->in = sim->lastin;
+    sim->lastin = tmp;
+
+    // clear what states we are in
+    int i;
+    for (i = 0; i < sim->pat->nfa_len; i++) {
+        sim->in[i] = false;
+    }
+
+    sim->nbytes++;
+
+    // now, traverse where we were in (lastin), and see if we can transition to any new states,
+    //   and add those to the current states we're in
+    for (i = 0; i < sim->pat->nfa_len; i++) {
+        if (sim->lastin[i]) {
+            struct cre_node* n = &sim->pat->nfa[i];
+
+            // whether the current character ('c') matches the current node
+            bool valid = false;
+            if (n->kind == cre_SET) {
+                valid = n->set[(unsigned char)c];
+            }
+
+            if (valid) {
+                // since this state is valid, try to transition to other states as well
+                if (cre_sim_add_(sim, n->u)) res = true;
+                if (cre_sim_add_(sim, n->v)) res = true;
+            }
+        }
+    }
+
+    return res;
+}
+
+bool
+cre_sim_feedz(cre_sim* sim, enum cre_z z) {
+    if (z == cre_START) {
+        // begin a new match attempt, alongside whatever is currently active
+        // NOTE: if the start state was already added, 'cre_sim_add_' won't reach the
+        //         accept again, so check 'null' too
+        return cre_sim_add_(sim, sim->pat->nfa_start) || sim->null;
+    } else if (z == cre_END && sim->words) {
+        // the end of the input isn't a word character, and since nothing can follow it,
+        //   nothing needs to be added
+        sim->bound = sim->word;
+        bool res = cre_sim_reach_(sim);
+        sim->bound = -1;
+        return res;
+    }
+    return false;
+}
+
+// check the limits of 'budget' that are too expensive to check on every byte
+static int
+cre_budget_check_(const cre_budget* budget, size_t nsteps) {
+    if (budget->cancel && *budget->cancel) {
+        return cre_CANCEL;
+    }
+    if (budget->max_steps && nsteps > budget->max_steps) {
+        return cre_BUDGET;
+    }
+    if (budget->deadline && cre_now() >= budget->deadline) {
+        return cre_BUDGET;
+    }
+    return cre_NOMATCH;
+}
+
+int
+cre_sim_search(cre_sim* sim, const char* src, size_t len, const cre_budget* budget, size_t* end) {
+    // how many bytes we can feed before running out of the byte budget
+    size_t n = len;
+    bool trunc = false;
+    if (budget && budget->max_bytes) {
+        size_t left = budget->max_bytes > sim->nbytes ? budget->max_bytes - sim->nbytes : 0;
+        if (n > left) {
+            n = left;
+            trunc = true;
+        }
+    }
+
+    size_t i;
+    int res;
+    for (i = 0; i < n; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(budget, sim->nsteps);
+            if (res != cre_NOMATCH) return res;
+        }
+        // NOTE: if the start state itself accepts, then the (empty) pattern matches
+        //         everywhere, so it's fine to report it as ending after this byte
+        bool m = cre_sim_feedz(sim, cre_START);
+        if (cre_sim_feedc(sim, src[i]) || m) {
+            *end = i + 1;
+            return cre_MATCH;
+        }
+    }
+
+    // NOTE: a match may also start after the last byte (i.e. '\B' at the end), so start
+    //         one there too, for when 'cre_END' is fed
+    cre_sim_feedz(sim, cre_START);
+
+    if (budget) {
+        res = cre_budget_check_(budget, sim->nsteps);
+        if (res != cre_NOMATCH) return res;
+    }
+    return trunc ? cre_BUDGET : cre_NOMATCH;
+}
+
+int64_t
+cre_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+//// IMPL: cre_tdfa ////
+
+// builder for a 'cre_tdfa', which keeps the thread lists of each state while building
+struct cre_tdfa_b_ {
+    cre_tdfa* d;
+
+    // thread lists of each state (NFA nodes, with -2 for the accepting thread), with
+    //   state 's' at 'thr[throff[s]]' up to 'thr[throff[s + 1]]'
+    int* thr;
+    int* throff;
+    int thr_cap;
+
+    // whether a state has had a match, so no new threads are started in it
+    bool* matched;
+    int states_cap;
+
+    // hash table of states
+    int* tab;
+    int tab_cap;
+
+    // number (and capacity) of operation pairs
+    int ops_len, ops_cap;
+
+    // new thread list being built: NFA node, which thread it came from (-1 for a new one),
+    //   and which tags were set along the way
+    int* lnode;
+    int* lsrc;
+    uint64_t* lmask;
+    int llen;
+    bool lacc;
+
+    // scratch space for closures
+    bool* mark;
+    int* vis;
+    int nvis;
+    int* stack;
+    uint64_t* mstack;
+};
+
+// follow epsilon/tag edges from 'i' in priority order, adding threads to the new list
+static void
+cre_tdfa_closure_(struct cre_tdfa_b_* B, int i, int src, uint64_t mask) {
+    cre_pat* pat = B->d->pat;
+    int sp = 0;
+    B->stack[sp] = i;
+    B->mstack[sp++] = mask;
+    while (sp > 0) {
+        sp--;
+        i = B->stack[sp];
+        mask = B->mstack[sp];
+        if (i == -1) continue;
+        if (i <= -2) {
+            // only the first (highest priority) accepting thread matters
+            if (!B->lacc) {
+                B->lacc = true;
+                B->lnode[B->llen] = -2;
+                B->lsrc[B->llen] = src;
+                B->lmask[B->llen++] = mask;
+            }
+            continue;
+        }
+        if (B->mark[i]) continue;
+        B->mark[i] = true;
+        B->vis[B->nvis++] = i;
+
+        struct cre_node* n = &pat->nfa[i];
+        if (n->kind == cre_SET) {
+            B->lnode[B->llen] = i;
+            B->lsrc[B->llen] = src;
+            B->lmask[B->llen++] = mask;
+        } else {
+            if (n->kind == cre_TAG) mask |= (uint64_t)1 << n->tag;
+            // push 'v' first, so 'u' (and everything after it) is visited first
+            B->stack[sp] = n->v;
+            B->mstack[sp++] = mask;
+            B->stack[sp] = n->u;
+            B->mstack[sp++] = mask;
+        }
+    }
+}
+
+// add register operations for moving to the new list (from a state with 'nthr' threads)
+static void
+cre_tdfa_addops_(struct cre_tdfa_b_* B) {
+    cre_tdfa* d = B->d;
+    int T = d->ntags, k, t;
+    for (k = 0; k < B->llen; ++k) {
+        for (t = 0; t < T; ++t) {
+            int dst = k * T + t, src;
+            if ((B->lmask[k] >> t) & 1) {
+                src = cre_TDFA_POS;
+            } else if (B->lsrc[k] < 0) {
+                src = cre_TDFA_NONE;
+            } else if (B->lsrc[k] != k) {
+                src = B->lsrc[k] * T + t;
+            } else {
+                // same thread, same register
+                continue;
+            }
+            if (B->ops_len >= B->ops_cap) {
+                B->ops_cap = B->ops_cap * 2 + 64;
+                d->ops = realloc(d->ops, sizeof(*d->ops) * 2 * B->ops_cap);
+            }
+            d->ops[2 * B->ops_len] = dst;
+            d->ops[2 * B->ops_len + 1] = src;
+            B->ops_len++;
+        }
+    }
+}
+
+// find (or add) the state for the new list, returning its index, or -1 if there are too many
+static int
+cre_tdfa_state_(struct cre_tdfa_b_* B, bool matched, int max_states) {
+    cre_tdfa* d = B->d;
+    int i;
+    uint64_t h = matched ? 1 : 2;
+    for (i = 0; i < B->llen; ++i) {
+        h = (h ^ (uint64_t)(B->lnode[i] + 2)) * 0x100000001b3ULL;
+    }
+    int k = h & (B->tab_cap - 1);
+    while (B->tab[k] >= 0) {
+        int s = B->tab[k], n = B->throff[s + 1] - B->throff[s];
+        if (B->matched[s] == matched && n == B->llen && memcmp(&B->thr[B->throff[s]], B->lnode, sizeof(int) * n) == 0) {
+            return s;
+        }
+        k = (k + 1) & (B->tab_cap - 1);
+    }
+    if (d->nstates >= max_states || B->llen * d->ntags > cre_TDFA_MAX_REGS) {
+        return -1;
+    }
+
+    // add a new state
+    int s = d->nstates++;
+    if (d->nstates >= B->states_cap) {
+        B->states_cap = B->states_cap * 2 + 16;
+        B->throff = realloc(B->throff, sizeof(*B->throff) * (B->states_cap + 1));
+        B->matched = realloc(B->matched, sizeof(*B->matched) * B->states_cap);
+        d->acc = realloc(d->acc, sizeof(*d->acc) * B->states_cap);
+        d->live = realloc(d->live, sizeof(*d->live) * B->states_cap);
+    }
+    if (B->throff[s] + B->llen > B->thr_cap) {
+        B->thr_cap = (B->throff[s] + B->llen) * 2;
+        B->thr = realloc(B->thr, sizeof(*B->thr) * B->thr_cap);
+    }
+    memcpy(&B->thr[B->throff[s]], B->lnode, sizeof(int) * B->llen);
+    B->throff[s + 1] = B->throff[s] + B->llen;
+    B->matched[s] = matched;
+    d->acc[s] = -1;
+    d->live[s] = false;
+    for (i = 0; i < B->llen; ++i) {
+        if (B->lnode[i] == -2) {
+            d->acc[s] = i;
+        } else {
+            d->live[s] = true;
+        }
+    }
+    if (B->llen * d->ntags > d->nregs) d->nregs = B->llen * d->ntags;
+    B->tab[k] = s;
+    return s;
+}
+
+// start a new list (clearing the marks from the last one)
+static void
+cre_tdfa_clear_(struct cre_tdfa_b_* B) {
+    int i;
+    for (i = 0; i < B->nvis; ++i) {
+        B->mark[B->vis[i]] = false;
+    }
+    B->nvis = 0;
+    B->llen = 0;
+    B->lacc = false;
+}
+
+int
+cre_tdfa_init(cre_tdfa* d, cre_pat* pat, const cre_budget* budget) {
+    int N = pat->nfa_len, i, c;
+    memset(d, 0, sizeof(*d));
+    d->pat = pat;
+    d->ntags = 2 * (pat->ngroups + 1);
+    if (d->ntags > 64) {
+        // tags are kept in a 64 bit mask
+        return cre_BUDGET;
+    }
+    if (cre_pat_words_(pat)) {
+        // word boundaries would need a byte of lookahead in the tag operations
+        return cre_BUDGET;
+    }
+    d->ncls = cre_pat_classes(pat, d->cls);
+    int rep[256];
+    for (i = 255; i >= 0; --i) {
+        rep[d->cls[i]] = i;
+    }
+    int max_states = budget && budget->max_states ? budget->max_states : cre_TDFA_MAX_STATES;
+
+    struct cre_tdfa_b_ B;
+    memset(&B, 0, sizeof(B));
+    B.d = d;
+    B.tab_cap = 16;
+    while (B.tab_cap < 2 * max_states) B.tab_cap *= 2;
+    B.tab = malloc(sizeof(*B.tab) * B.tab_cap);
+    for (i = 0; i < B.tab_cap; ++i) {
+        B.tab[i] = -1;
+    }
+    B.states_cap = 16;
+    B.throff = malloc(sizeof(*B.throff) * (B.states_cap + 1));
+    B.throff[0] = 0;
+    B.matched = malloc(sizeof(*B.matched) * B.states_cap);
+    d->acc = malloc(sizeof(*d->acc) * B.states_cap);
+    d->live = malloc(sizeof(*d->live) * B.states_cap);
+    // at most one thread per node, plus the accepting one
+    B.lnode = malloc(sizeof(*B.lnode) * (N + 1));
+    B.lsrc = malloc(sizeof(*B.lsrc) * (N + 1));
+    B.lmask = malloc(sizeof(*B.lmask) * (N + 1));
+    B.mark = calloc(N + 1, sizeof(*B.mark));
+    B.vis = malloc(sizeof(*B.vis) * (N + 1));
+    B.stack = malloc(sizeof(*B.stack) * (2 * N + 2));
+    B.mstack = malloc(sizeof(*B.mstack) * (2 * N + 2));
+
+    int res = 0, trans_cap = 0;
+
+    // the start state, which starts a thread that sets tag 0 (the start of the match)
+    cre_tdfa_clear_(&B);
+    cre_tdfa_closure_(&B, pat->nfa_start, -1, 1);
+    cre_tdfa_addops_(&B);
+    d->start = cre_tdfa_state_(&B, B.lacc, max_states);
+    if (d->start < 0) res = cre_BUDGET;
+
+    // now, build the transitions of each state, in order (which adds more states)
+    int s;
+    for (s = 0; res == 0 && s < d->nstates; ++s) {
+        if (budget) {
+            res = cre_budget_check_(budget, 0);
+            if (res != 0) break;
+        }
+        if ((s + 1) * d->ncls > trans_cap) {
+            trans_cap = (s + 1) * d->ncls * 2;
+            d->trans = realloc(d->trans, sizeof(*d->trans) * trans_cap);
+            d->opsoff = realloc(d->opsoff, sizeof(*d->opsoff) * (trans_cap + 1));
+        }
+        for (c = 0; c < d->ncls; ++c) {
+            d->opsoff[s * d->ncls + c] = B.ops_len;
+            cre_tdfa_clear_(&B);
+
+            // step each thread, in priority order
+            int b = rep[c], k;
+            for (k = 0; k < B.throff[s + 1] - B.throff[s]; ++k) {
+                int j = B.thr[B.throff[s] + k];
+                if (j >= 0 && pat->nfa[j].set[b]) {
+                    cre_tdfa_closure_(&B, pat->nfa[j].u, k, 0);
+                    cre_tdfa_closure_(&B, pat->nfa[j].v, k, 0);
+                }
+            }
+            // if nothing has matched, start a new (lowest priority) thread at the next position
+            bool matched = B.matched[s] || B.lacc;
+            if (!matched) {
+                cre_tdfa_closure_(&B, pat->nfa_start, -1, 1);
+                matched = B.lacc;
+            }
+            cre_tdfa_addops_(&B);
+
+            int t = cre_tdfa_state_(&B, matched, max_states);
+            if (t < 0) {
+                res = cre_BUDGET;
+                break;
+            }
+            d->trans[s * d->ncls + c] = t;
+        }
+    }
+    if (res == 0) {
+        d->opsoff[d->nstates * d->ncls] = B.ops_len;
+    }
+
+    free(B.thr);
+    free(B.throff);
+    free(B.matched);
+    free(B.tab);
+    free(B.lnode);
+    free(B.lsrc);
+    free(B.lmask);
+    free(B.mark);
+    free(B.vis);
+    free(B.stack);
+    free(B.mstack);
+
+    if (res != 0) {
+        cre_tdfa_free(d);
+        return res;
+    }
+
+    // the entry operations (before 'opsoff[0]') may write any register too
+    if (d->nregs < d->ntags) d->nregs = d->ntags;
+    d->regs = malloc(sizeof(*d->regs) * d->nregs);
+    d->tmp = malloc(sizeof(*d->tmp) * d->nregs);
+    return 0;
+}
+
+void
+cre_tdfa_free(cre_tdfa* d) {
+    free(d->trans);
+    free(d->opsoff);
+    free(d->ops);
+    free(d->acc);
+    free(d->live);
+    free(d->regs);
+    free(d->tmp);
+}
+
+void
+cre_tdfa_memory_usage(cre_tdfa* d, cre_mem* res) {
+    size_t nt = (size_t)d->nstates * d->ncls;
+    memset(res, 0, sizeof(*res));
+    res->classes = sizeof(d->cls);
+    // NOTE: it is built all at once, so this is what is used (not counting unused room)
+    res->dfa = (sizeof(*d->trans) + sizeof(*d->opsoff)) * nt + sizeof(*d->opsoff) + 2 * sizeof(*d->ops) * d->opsoff[nt]
+             + (sizeof(*d->acc) + sizeof(*d->live)) * d->nstates;
+    res->scratch = (sizeof(*d->regs) + sizeof(*d->tmp)) * d->nregs;
+    cre_mem_total_(res);
+}
+
+// apply 'n' register operations (in parallel, i.e. all reads happen before all writes)
+static void
+cre_tdfa_apply_(cre_tdfa* d, const int* ops, int n, int64_t pos) {
+    int i;
+    for (i = 0; i < n; ++i) {
+        int src = ops[2 * i + 1];
+        d->tmp[i] = src == cre_TDFA_POS ? pos : src == cre_TDFA_NONE ? -1 : d->regs[src];
+    }
+    for (i = 0; i < n; ++i) {
+        d->regs[ops[2 * i]] = d->tmp[i];
+    }
+}
+
+int
+cre_tdfa_search(cre_tdfa* d, const char* src, size_t len, const cre_budget* budget, int64_t* groups) {
+    int T = d->ntags, s = d->start, res = cre_NOMATCH, i;
+    size_t n = len, p;
+    bool trunc = false;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+
+    // enter the start state at position 0
+    cre_tdfa_apply_(d, d->ops, d->opsoff[0], 0);
+    p = 0;
+    while (true) {
+        if (d->acc[s] >= 0) {
+            // a thread accepted, so keep it if it starts at least as early as the best so far
+            //   (if it starts at the same place, it's longer)
+            int64_t* r = &d->regs[d->acc[s] * T];
+            if (res != cre_MATCH || r[0] <= groups[0]) {
+                res = cre_MATCH;
+                for (i = 0; i < T; ++i) {
+                    groups[i] = r[i];
+                }
+                groups[1] = p;
+            }
+        }
+        if (!d->live[s] || p >= n) break;
+        if (budget && p % cre_CHECK_EVERY == 0) {
+            int r = cre_budget_check_(budget, 0);
+            if (r != cre_NOMATCH) return r;
+        }
+
+        // take the transition, and apply its operations
+        int t = s * d->ncls + d->cls[(unsigned char)src[p++]];
+        cre_tdfa_apply_(d, &d->ops[2 * d->opsoff[t]], d->opsoff[t + 1] - d->opsoff[t], p);
+        s = d->trans[t];
+    }
+
+    // if we ran out of bytes, a (longer) match might have been cut off
+    if (trunc && d->live[s]) return cre_BUDGET;
+    return res;
+}
+
+//// IMPL: cre_drv ////
+
+// well-known nodes, which are always first
+#define cre_DRV_N_EMPTY 0
+#define cre_DRV_N_EPS   1
+#define cre_DRV_N_FULL  2
+
+// get (or add) a node, without simplifying it
+static int
+cre_drv_mk_(cre_drv* d, enum cre_drv_kind kind, int a, int b, const uint64_t* set) {
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    if (set) memcpy(s, set, sizeof(s));
+    uint64_t h = ((uint64_t)kind * 0x9e3779b97f4a7c15ULL) ^ ((uint64_t)(a + 1) << 32) ^ (uint64_t)(b + 1);
+    int i;
+    for (i = 0; i < 4; ++i) {
+        h = (h ^ s[i]) * 0x100000001b3ULL;
+    }
+    h ^= h >> 29;
+
+    int k = h & (d->tab_cap - 1);
+    while (d->tab[k] >= 0) {
+        struct cre_drv_node* n = &d->nodes[d->tab[k]];
+        if (n->kind == kind && n->a == a && n->b == b && memcmp(n->set, s, sizeof(s)) == 0) {
+            return d->tab[k];
+        }
+        k = (k + 1) & (d->tab_cap - 1);
+    }
+
+    // add a new node
+    if (d->nodes_len >= d->nodes_cap) {
+        d->nodes_cap = d->nodes_cap * 2 + 64;
+        d->nodes = realloc(d->nodes, sizeof(*d->nodes) * d->nodes_cap);
+    }
+    int r = d->nodes_len++;
+    struct cre_drv_node* n = &d->nodes[r];
+    n->kind = kind;
+    n->a = a;
+    n->b = b;
+    memcpy(n->set, s, sizeof(s));
+    n->state = -1;
+    switch (kind) {
+    case cre_DRV_EMPTY: case cre_DRV_SET: n->nullable = false; break;
+    case cre_DRV_EPS: case cre_DRV_STAR: n->nullable = true; break;
+    case cre_DRV_CAT: case cre_DRV_AND: n->nullable = d->nodes[a].nullable && d->nodes[b].nullable; break;
+    case cre_DRV_ALT: n->nullable = d->nodes[a].nullable || d->nodes[b].nullable; break;
+    case cre_DRV_NOT: n->nullable = !d->nodes[a].nullable; break;
+    }
+    d->tab[k] = r;
+
+    // keep the hash table at most half full
+    if (2 * d->nodes_len > d->tab_cap) {
+        d->tab_cap *= 2;
+        d->tab = realloc(d->tab, sizeof(*d->tab) * d->tab_cap);
+        for (i = 0; i < d->tab_cap; ++i) {
+            d->tab[i] = -1;
+        }
+        int old = d->nodes_len;
+        d->nodes_len = 0;
+        for (i = 0; i < old; ++i) {
+            struct cre_drv_node m = d->nodes[i];
+            int st = m.state;
+            cre_drv_mk_(d, m.kind, m.a, m.b, m.set);
+            d->nodes[i].state = st;
+        }
+    }
+    return r;
+}
+
+static int
+cre_drv_cmp_(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+// make an 'a|b' or 'a&b' node, which are kept as sorted, right-nested lists without
+//   duplicates (so that equivalent regexes get the same node)
+static int
+cre_drv_list_(cre_drv* d, enum cre_drv_kind kind, int a, int b) {
+    // for '|', nothing (EMPTY) is the identity, and everything (FULL) absorbs, and
+    //   for '&', it's the other way around
+    int ident = kind == cre_DRV_ALT ? cre_DRV_N_EMPTY : cre_DRV_N_FULL;
+    int absorb = kind == cre_DRV_ALT ? cre_DRV_N_FULL : cre_DRV_N_EMPTY;
+    if (a == absorb || b == absorb) return absorb;
+    if (a == ident || a == b) return b;
+    if (b == ident) return a;
+
+    // flatten both sides
+    int n = 0, cap = 8, i, x;
+    int* items = malloc(sizeof(*items) * cap);
+    int sides[2] = { a, b };
+    for (i = 0; i < 2; ++i) {
+        x = sides[i];
+        while (true) {
+            if (n + 1 >= cap) {
+                cap *= 2;
+                items = realloc(items, sizeof(*items) * cap);
+            }
+            if (d->nodes[x].kind == kind) {
+                items[n++] = d->nodes[x].a;
+                x = d->nodes[x].b;
+            } else {
+                items[n++] = x;
+                break;
+            }
+        }
+    }
+    qsort(items, n, sizeof(*items), cre_drv_cmp_);
+
+    // rebuild from the end, skipping duplicates
+    int r = items[n - 1];
+    for (i = n - 2; i >= 0; --i) {
+        if (items[i] != items[i + 1]) {
+            r = cre_drv_mk_(d, kind, items[i], r, NULL);
+        }
+    }
+    free(items);
+    return r;
+}
+
+static int
+cre_drv_cat_(cre_drv* d, int a, int b) {
+    if (a == cre_DRV_N_EMPTY || b == cre_DRV_N_EMPTY) return cre_DRV_N_EMPTY;
+    if (a == cre_DRV_N_EPS) return b;
+    if (b == cre_DRV_N_EPS) return a;
+    if (d->nodes[a].kind == cre_DRV_CAT) {
+        // keep concatenations right-nested
+        int x = d->nodes[a].a, y = d->nodes[a].b;
+        return cre_drv_mk_(d, cre_DRV_CAT, x, cre_drv_cat_(d, y, b), NULL);
+    }
+    return cre_drv_mk_(d, cre_DRV_CAT, a, b, NULL);
+}
+
+static int
+cre_drv_not_(cre_drv* d, int a) {
+    if (d->nodes[a].kind == cre_DRV_NOT) return d->nodes[a].a;
+    return cre_drv_mk_(d, cre_DRV_NOT, a, -1, NULL);
+}
+
+static int
+cre_drv_star_(cre_drv* d, int a) {
+    if (a == cre_DRV_N_EMPTY || a == cre_DRV_N_EPS) return cre_DRV_N_EPS;
+    if (d->nodes[a].kind == cre_DRV_STAR) return a;
+    return cre_drv_mk_(d, cre_DRV_STAR, a, -1, NULL);
+}
+
+// make a set node from a 'bool[256]' set
+static int
+cre_drv_set_(cre_drv* d, const bool* set) {
+    uint64_t s[4] = { 0, 0, 0, 0 };
+    int i;
+    bool any = false;
+    for (i = 0; i < 256; ++i) {
+        if (set[i]) {
+            s[i / 64] |= (uint64_t)1 << (i % 64);
+            any = true;
+        }
+    }
+    return any ? cre_drv_mk_(d, cre_DRV_SET, -1, -1, s) : cre_DRV_N_EMPTY;
+}
+
+// take the derivative of 'r' with respect to byte 'c', i.e. what is left to match after 'c'
+static int
+cre_drv_deriv_(cre_drv* d, int r, unsigned char c) {
+    struct cre_drv_node n = d->nodes[r];
+    switch (n.kind) {
+    case cre_DRV_EMPTY:
+    case cre_DRV_EPS:
+        return cre_DRV_N_EMPTY;
+    case cre_DRV_SET:
+        return (n.set[c / 64] >> (c % 64)) & 1 ? cre_DRV_N_EPS : cre_DRV_N_EMPTY;
+    case cre_DRV_CAT: {
+        int x = cre_drv_cat_(d, cre_drv_deriv_(d, n.a, c), n.b);
+        if (d->nodes[n.a].nullable) {
+            x = cre_drv_list_(d, cre_DRV_ALT, x, cre_drv_deriv_(d, n.b, c));
+        }
+        return x;
+    }
+    case cre_DRV_ALT:
+    case cre_DRV_AND: {
+        int x = cre_drv_deriv_(d, n.a, c);
+        return cre_drv_list_(d, n.kind, x, cre_drv_deriv_(d, n.b, c));
+    }
+    case cre_DRV_NOT:
+        return cre_drv_not_(d, cre_drv_deriv_(d, n.a, c));
+    case cre_DRV_STAR:
+        return cre_drv_cat_(d, cre_drv_deriv_(d, n.a, c), r);
+    }
+    return cre_DRV_N_EMPTY;
+}
+
+/// parser ///
+
+static int
+cre_drv_parse_alt_(cre_drv* d, struct cre_parser_* P);
+
+static int
+cre_drv_parse_atom_(cre_drv* d, struct cre_parser_* P) {
+    bool set[256] = { false };
+    char c = *P->s;
+    int i;
+    if (c == '(') {
+        P->s++;
+        if (P->s[0] == '?' && P->s[1] == ':') P->s += 2;
+        if (P->depth >= cre_MAX_DEPTH) {
+            cre_parse_err_(P, "groups are nested too deeply");
+            return cre_DRV_N_EMPTY;
+        }
+        P->depth++;
+        int r = cre_drv_parse_alt_(d, P);
+        P->depth--;
+        if (*P->s != ')') {
+            cre_parse_err_(P, "missing ')'");
+        } else {
+            P->s++;
+        }
+        return r;
+    } else if (c == '[') {
+        P->s++;
+        cre_parse_bracket_(P, set);
+    } else if (c == '.') {
+        P->s++;
+        for (i = 0; i < 256; ++i) {
+            set[i] = i != '\n';
+        }
+    } else if (c == '*' || c == '+' || c == '?' || c == '{') {
+        cre_parse_err_(P, "nothing to repeat");
+    } else if (c == '\\' && (P->s[1] == 'b' || P->s[1] == 'B')) {
+        P->s += 2;
+        cre_parse_err_(P, "word boundaries aren't supported with derivatives");
+    } else if (c == '\\') {
+        P->s++;
+        if (cre_parse_class_(set, *P->s)) {
+            P->s++;
+        } else {
+            int b = cre_parse_esc_(P);
+            if (b >= 0) set[b] = true;
+        }
+    } else {
+        P->s++;
+        set[(unsigned char)c] = true;
+    }
+    return cre_drv_set_(d, set);
+}
+
+static int
+cre_drv_parse_rep_(cre_drv* d, struct cre_parser_* P) {
+    if (*P->s == '~') {
+        P->s++;
+        return cre_drv_not_(d, cre_drv_parse_rep_(d, P));
+    }
+    int r = cre_drv_parse_atom_(d, P);
+    while (!P->err) {
+        char c = *P->s;
+        if (c == '*') {
+            P->s++;
+            r = cre_drv_star_(d, r);
+        } else if (c == '+') {
+            P->s++;
+            r = cre_drv_cat_(d, r, cre_drv_star_(d, r));
+        } else if (c == '?') {
+            P->s++;
+            r = cre_drv_list_(d, cre_DRV_ALT, cre_DRV_N_EPS, r);
+        } else if (c == '{') {
+            P->s++;
+            int n = cre_parse_num_(P), m = n, i;
+            if (*P->s == ',') {
+                P->s++;
+                m = *P->s == '}' ? -1 : cre_parse_num_(P);
+            }
+            if (P->err) break;
+            if (*P->s != '}') {
+                cre_parse_err_(P, "missing '}'");
+                break;
+            }
+            P->s++;
+            if (m >= 0 && m < n) {
+                cre_parse_err_(P, "invalid range in '{n,m}'");
+                break;
+            }
+            // 'r{n,m}' is 'r' n times, followed by 'r?' (m-n) times (or 'r*')
+            // NOTE: since nodes are hash-consed, the copies don't take up any space
+            int x = m < 0 ? cre_drv_star_(d, r) : cre_DRV_N_EPS;
+            int opt = cre_drv_list_(d, cre_DRV_ALT, cre_DRV_N_EPS, r);
+            for (i = n; i < m; ++i) {
+                x = cre_drv_cat_(d, opt, x);
+            }
+            for (i = 0; i < n; ++i) {
+                x = cre_drv_cat_(d, r, x);
+            }
+            r = x;
+        } else {
+            break;
+        }
+    }
+    return r;
+}
+
+static int
+cre_drv_parse_cat_(cre_drv* d, struct cre_parser_* P) {
+    // build the list of parts, then concatenate them from the right
+    int n = 0, cap = 8, r = cre_DRV_N_EPS, i;
+    int* parts = malloc(sizeof(*parts) * cap);
+    while (!P->err && *P->s != '\0' && *P->s != '|' && *P->s != '&' && *P->s != ')') {
+        if (n >= cap) {
+            cap *= 2;
+            parts = realloc(parts, sizeof(*parts) * cap);
+        }
+        parts[n++] = cre_drv_parse_rep_(d, P);
+    }
+    for (i = n - 1; i >= 0; --i) {
+        r = cre_drv_cat_(d, parts[i], r);
+    }
+    free(parts);
+    return r;
+}
+
+static int
+cre_drv_parse_and_(cre_drv* d, struct cre_parser_* P) {
+    int r = cre_drv_parse_cat_(d, P);
+    while (!P->err && *P->s == '&') {
+        P->s++;
+        r = cre_drv_list_(d, cre_DRV_AND, r, cre_drv_parse_cat_(d, P));
+    }
+    return r;
+}
+
+static int
+cre_drv_parse_alt_(cre_drv* d, struct cre_parser_* P) {
+    int r = cre_drv_parse_and_(d, P);
+    while (!P->err && *P->s == '|') {
+        P->s++;
+        r = cre_drv_list_(d, cre_DRV_ALT, r, cre_drv_parse_and_(d, P));
+    }
+    return r;
+}
+
+/// DFA ///
+
+// set up an empty node table, with the well-known nodes
+static void
+cre_drv_reset_nodes_(cre_drv* d) {
+    int i;
+    d->nodes_len = 0;
+    for (i = 0; i < d->tab_cap; ++i) {
+        d->tab[i] = -1;
+    }
+    cre_drv_mk_(d, cre_DRV_EMPTY, -1, -1, NULL);
+    cre_drv_mk_(d, cre_DRV_EPS, -1, -1, NULL);
+    cre_drv_mk_(d, cre_DRV_NOT, cre_DRV_N_EMPTY, -1, NULL);
+}
+
+char*
+cre_drv_init(cre_drv* d, const char* src, int cache_states) {
+    memset(d, 0, sizeof(*d));
+    int sl = strlen(src), i;
+    d->src = malloc(sl + 1);
+    memcpy(d->src, src, sl + 1);
+    d->tab_cap = 256;
+    d->tab = malloc(sizeof(*d->tab) * d->tab_cap);
+    cre_drv_reset_nodes_(d);
+
+    struct cre_parser_ P;
+    P.pat = NULL;
+    P.nfa_cap = 0;
+    P.src = P.s = src;
+    P.depth = 0;
+    P.err = NULL;
+    d->root = cre_drv_parse_alt_(d, &P);
+    if (!P.err && *P.s == ')') {
+        cre_parse_err_(&P, "unmatched ')'");
+    }
+    if (P.err) {
+        cre_drv_free(d);
+        return P.err;
+    }
+
+    // byte classes, from every set in the regex
+    int ncls = 1, j;
+    int map[512];
+    memset(d->cls, 0, sizeof(d->cls));
+    for (i = 0; i < d->nodes_len; ++i) {
+        struct cre_drv_node* n = &d->nodes[i];
+        if (n->kind != cre_DRV_SET) continue;
+        for (j = 0; j < 512; ++j) {
+            map[j] = -1;
+        }
+        ncls = 0;
+        for (j = 0; j < 256; ++j) {
+            int k = d->cls[j] * 2 + ((n->set[j / 64] >> (j % 64)) & 1);
+            if (map[k] < 0) map[k] = ncls++;
+            d->cls[j] = map[k];
+        }
+    }
+    d->ncls = ncls;
+
+    // searching is matching '(.|\n)*' first
+    uint64_t all[4] = { ~(uint64_t)0, ~(uint64_t)0, ~(uint64_t)0, ~(uint64_t)0 };
+    d->uroot = cre_drv_cat_(d, cre_drv_star_(d, cre_drv_mk_(d, cre_DRV_SET, -1, -1, all)), d->root);
+
+    d->max_states = cache_states > 0 ? cache_states : cre_DRV_CACHE_STATES;
+    d->snode = malloc(sizeof(*d->snode) * d->max_states);
+    d->trans = malloc(sizeof(*d->trans) * d->max_states * d->ncls);
+    d->nstates = 0;
+    return NULL;
+}
+
+void
+cre_drv_free(cre_drv* d) {
+    free(d->src);
+    free(d->nodes);
+    free(d->tab);
+    free(d->snode);
+    free(d->trans);
+}
+
+void
+cre_drv_memory_usage(cre_drv* d, cre_mem* res) {
+    memset(res, 0, sizeof(*res));
+    res->nfa = strlen(d->src) + 1;
+    res->classes = sizeof(d->cls);
+    // NOTE: the state tables are made up front, and the nodes keep their room after a flush
+    res->dfa = sizeof(*d->nodes) * d->nodes_cap + sizeof(*d->tab) * d->tab_cap
+             + (sizeof(*d->snode) + sizeof(*d->trans) * d->ncls) * d->max_states;
+    cre_mem_total_(res);
+}
+
+// copy node 'r' from 'old' into the (new) node table of 'd', returning its new index
+static int
+cre_drv_copy_(cre_drv* d, struct cre_drv_node* old, int* map, int r) {
+    if (map[r] >= 0) return map[r];
+    struct cre_drv_node* n = &old[r];
+    int a = n->a >= 0 ? cre_drv_copy_(d, old, map, n->a) : -1;
+    int b = n->b >= 0 ? cre_drv_copy_(d, old, map, n->b) : -1;
+    return map[r] = cre_drv_mk_(d, n->kind, a, b, n->set);
+}
+
+// flush the cache, keeping only the nodes needed for the roots and 'keep' (returning
+//   its new index)
+static int
+cre_drv_flush_(cre_drv* d, int keep) {
+    int len = d->nodes_len, i;
+    struct cre_drv_node* old = malloc(sizeof(*old) * len);
+    memcpy(old, d->nodes, sizeof(*old) * len);
+    int* map = malloc(sizeof(*map) * len);
+    for (i = 0; i < len; ++i) {
+        map[i] = -1;
+    }
+    cre_drv_reset_nodes_(d);
+    map[cre_DRV_N_EMPTY] = cre_DRV_N_EMPTY;
+    map[cre_DRV_N_EPS] = cre_DRV_N_EPS;
+    map[cre_DRV_N_FULL] = cre_DRV_N_FULL;
+    d->root = cre_drv_copy_(d, old, map, d->root);
+    d->uroot = cre_drv_copy_(d, old, map, d->uroot);
+    keep = cre_drv_copy_(d, old, map, keep);
+    free(old);
+    free(map);
+    d->nstates = 0;
+    d->nflush++;
+    return keep;
+}
+
+// get the DFA state for node 'r', adding it if needed (which may flush the cache)
+static int
+cre_drv_state_(cre_drv* d, int r) {
+    if (d->nodes[r].state >= 0) return d->nodes[r].state;
+    if (d->nstates >= d->max_states) {
+        r = cre_drv_flush_(d, r);
+    }
+    int s = d->nstates++, c;
+    d->snode[s] = r;
+    for (c = 0; c < d->ncls; ++c) {
+        d->trans[s * d->ncls + c] = -1;
+    }
+    d->nodes[r].state = s;
+    return s;
+}
+
+// run the DFA over 'src', starting from node 'r', stopping at the first accepting
+//   position if 'end' is given
+static int
+cre_drv_run_(cre_drv* d, int r, const char* src, size_t len, const cre_budget* budget, size_t* end) {
+    size_t n = len, i;
+    bool trunc = false;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+    // number of states built during this run
+    size_t nbuilt = 0;
+    int s = cre_drv_state_(d, r);
+    if (end && d->nodes[d->snode[s]].nullable && n > 0) {
+        // matches the empty string, so everything matches (see 'cre_sim_search')
+        *end = 1;
+        return cre_MATCH;
+    }
+    for (i = 0; i < n; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            int res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) return res;
+            if (budget->max_states && nbuilt > (size_t)budget->max_states) return cre_BUDGET;
+        }
+        int c = d->cls[(unsigned char)src[i]];
+        int t = d->trans[s * d->ncls + c];
+        if (t < 0) {
+            // compute the transition (the state we're in may be flushed, so look it up again)
+            int x = cre_drv_deriv_(d, d->snode[s], src[i]);
+            int fl = d->nflush;
+            t = cre_drv_state_(d, x);
+            if (fl == d->nflush) d->trans[s * d->ncls + c] = t;
+            nbuilt++;
+        }
+        s = t;
+        if (d->snode[s] == cre_DRV_N_EMPTY) {
+            // can never match
+            return trunc ? cre_BUDGET : cre_NOMATCH;
+        }
+        if (end && d->nodes[d->snode[s]].nullable) {
+            *end = i + 1;
+            return cre_MATCH;
+        }
+    }
+    if (trunc) return cre_BUDGET;
+    if (end) return cre_NOMATCH;
+    return d->nodes[d->snode[s]].nullable ? cre_MATCH : cre_NOMATCH;
+}
+
+int
+cre_drv_match(cre_drv* d, const char* src, size_t len, const cre_budget* budget) {
+    return cre_drv_run_(d, d->root, src, len, budget, NULL);
+}
+
+int
+cre_drv_search(cre_drv* d, const char* src, size_t len, const cre_budget* budget, size_t* end) {
+    return cre_drv_run_(d, d->uroot, src, len, budget, end);
+}
+
+//// IMPL: cre_apx ////
+
+char*
+cre_apx_init(cre_apx* a, cre_pat* pat, int k) {
+    struct cre_walk_ W;
+    cre_walk_init_(&W, pat);
+    W.words = true;
+    int* out = malloc(sizeof(*out) * (pat->nfa_len + 1));
+    int nout, i;
+    bool acc = false;
+    char* err = NULL;
+
+    // walk the pattern, which should only ever have one way to go
+    memset(a->masks, 0, sizeof(a->masks));
+    a->len = 0;
+    nout = cre_walk_closure_(&W, pat->nfa_start, -1, out, &acc, NULL);
+    while (nout == 1 && !acc && pat->nfa[out[0]].kind == cre_SET) {
+        struct cre_node* n = &pat->nfa[out[0]];
+        if (a->len >= 64) {
+            err = strdup("pattern is too long for approximate matching (max 64)");
+            break;
+        }
+        for (i = 0; i < 256; ++i) {
+            if (n->set[i]) a->masks[i] |= (uint64_t)1 << a->len;
+        }
+        a->len++;
+        acc = false;
+        nout = cre_walk_closure_(&W, n->u, n->v, out, &acc, NULL);
+    }
+    if (!err && (nout != 0 || !acc || a->len == 0)) {
+        err = strdup("approximate matching needs a pattern that is a sequence of characters and classes");
+    }
+    cre_walk_free_(&W);
+    free(out);
+    if (err) return err;
+
+    // NOTE: with as many errors as there are sets, everything matches (by deleting them all),
+    //         so more than that never changes anything (and would only take more memory)
+    a->k = k < 0 ? 0 : k > a->len ? a->len : k;
+    a->R = malloc(sizeof(*a->R) * (a->k + 1));
+    cre_apx_reset(a);
+    return NULL;
+}
+
+void
+cre_apx_free(cre_apx* a) {
+    free(a->R);
+}
+
+void
+cre_apx_memory_usage(cre_apx* a, cre_mem* res) {
+    memset(res, 0, sizeof(*res));
+    res->nfa = sizeof(a->masks);
+    res->scratch = sizeof(*a->R) * (a->k + 1);
+    cre_mem_total_(res);
+}
+
+void
+cre_apx_reset(cre_apx* a) {
+    // with 'd' errors, the first 'd' sets can always be matched (by deleting them)
+    int d;
+    for (d = 0; d <= a->k; ++d) {
+        a->R[d] = d >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << d) - 1;
+    }
+}
+
+int
+cre_apx_feedc(cre_apx* a, char c) {
+    uint64_t B = a->masks[(unsigned char)c], last = (uint64_t)1 << (a->len - 1);
+    // 'prev' is the old R[d-1], and R[d-1] is already the new one
+    uint64_t prev = a->R[0];
+    a->R[0] = ((a->R[0] << 1) | 1) & B;
+    int d, res = a->R[0] & last ? 0 : -1;
+    for (d = 1; d <= a->k; ++d) {
+        uint64_t old = a->R[d];
+        // match, or insertion (of 'c'), or substitution, or deletion (of a set)
+        a->R[d] = (((old << 1) | 1) & B) | prev | (prev << 1) | (a->R[d - 1] << 1) | 1;
+        if (res < 0 && (a->R[d] & last)) res = d;
+        prev = old;
+    }
+    return res;
+}
+
+int
+cre_apx_search(cre_apx* a, const char* src, size_t len, const cre_budget* budget, size_t* end, int* errs) {
+    size_t n = len, i;
+    bool trunc = false;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+    for (i = 0; i < n; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            int res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) return res;
+        }
+        int e = cre_apx_feedc(a, src[i]);
+        if (e >= 0) {
+            *end = i + 1;
+            *errs = e;
+            return cre_MATCH;
+        }
+    }
+    return trunc ? cre_BUDGET : cre_NOMATCH;
+}
+
+//// IMPL: cre_set ////
+
+char*
+cre_set_init(cre_set* set, const char** srcs, int len) {
+    cre_pat* pat = &set->pat;
+    int i, j, sl = 0;
+    set->len = len;
+    pat->nfa_len = 0;
+    pat->nfa = NULL;
+    pat->ngroups = 0;
+    pat->npats = len;
+
+    // the source is each pattern on its own line
+    for (i = 0; i < len; ++i) {
+        sl += strlen(srcs[i]) + 1;
+    }
+    pat->src = malloc(sl + 1);
+    pat->src[0] = '\0';
+    for (i = 0; i < len; ++i) {
+        strcat(pat->src, srcs[i]);
+        if (i < len - 1) strcat(pat->src, "\n");
+    }
+
+    // compile each pattern, and move its nodes into the combined NFA
+    int* starts = malloc(sizeof(*starts) * (len + 1));
+    for (i = 0; i < len; ++i) {
+        cre_pat p;
+        char* err = cre_pat_init(&p, srcs[i]);
+        if (err) {
+            int esz = strlen(err) + 32;
+            char* res = malloc(esz);
+            snprintf(res, esz, "pattern %d: %s", i, err);
+            free(err);
+            free(starts);
+            cre_pat_free(pat);
+            return res;
+        }
+        int off = pat->nfa_len;
+        pat->nfa_len += p.nfa_len;
+        pat->nfa = realloc(pat->nfa, sizeof(*pat->nfa) * (pat->nfa_len + len));
+        for (j = 0; j < p.nfa_len; ++j) {
+            struct cre_node* n = &pat->nfa[off + j];
+            *n = p.nfa[j];
+            n->u = n->u >= 0 ? n->u + off : n->u == -2 ? -2 - i : n->u;
+            n->v = n->v >= 0 ? n->v + off : n->v == -2 ? -2 - i : n->v;
+        }
+        starts[i] = p.nfa_start + off;
+        if (p.ngroups > pat->ngroups) pat->ngroups = p.ngroups;
+        // the sets now belong to the combined NFA
+        free(p.nfa);
+        free(p.src);
+    }
+
+    // then, link them with a chain of epsilon nodes
+    pat->nfa = realloc(pat->nfa, sizeof(*pat->nfa) * (pat->nfa_len + len + 1));
+    int next = -1;
+    for (i = len - 1; i >= 0; --i) {
+        if (next < 0) {
+            next = starts[i];
+            continue;
+        }
+        struct cre_node* n = &pat->nfa[pat->nfa_len];
+        n->kind = cre_EPS;
+        n->u = starts[i];
+        n->v = next;
+        n->set = NULL;
+        n->tag = -1;
+        next = pat->nfa_len++;
+    }
+    if (next < 0) {
+        // no patterns, so nothing matches
+        struct cre_node* n = &pat->nfa[pat->nfa_len];
+        n->kind = cre_EPS;
+        n->u = n->v = -1;
+        n->set = NULL;
+        n->tag = -1;
+        next = pat->nfa_len++;
+    }
+    pat->nfa_start = next;
+    free(starts);
+    return NULL;
+}
+
+void
+cre_set_free(cre_set* set) {
+    cre_pat_free(&set->pat);
+}
+
+void
+cre_set_memory_usage(cre_set* set, cre_mem* res) {
+    cre_pat_memory_usage(&set->pat, res);
+}
+
+
+//// IMPL: cre_dfa ////
+
+static int
+cre_dfa_cmp_(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+void
+cre_dfa_init(cre_dfa* d, cre_pat* pat, bool reverse, int max_states) {
+    int N = pat->nfa_len, P = pat->npats, i, j, k;
+    memset(d, 0, sizeof(*d));
+    d->pat = pat;
+    d->reverse = reverse;
+    d->ncls = cre_pat_classes(pat, d->cls);
+    d->max_states = max_states > 0 ? max_states : cre_DFA_MAX_STATES;
+    d->words = cre_pat_words_(pat);
+
+    // compute the (forward) follow lists, from the closure after each SET node (and each
+    //   word boundary, which is followed when it holds)
+    struct cre_walk_ W;
+    cre_walk_init_(&W, pat);
+    W.words = true;
+    bool* pmark = calloc(P + 1, sizeof(*pmark));
+    W.pats = malloc(sizeof(*W.pats) * (P + 1));
+    W.pmark = pmark;
+    int* out = malloc(sizeof(*out) * (N + 1));
+    int fcap = N + 16, acap = 16, flen = 0, alen = 0, nout;
+    int* foloff = malloc(sizeof(*foloff) * (N + 1));
+    int* fol = malloc(sizeof(*fol) * fcap);
+    int* facoff = malloc(sizeof(*facoff) * (N + 1));
+    int* fac = malloc(sizeof(*fac) * acap);
+    for (i = 0; i <= N; ++i) {
+        foloff[i] = flen;
+        facoff[i] = alen;
+        if (i == N || !cre_node_waits_(&pat->nfa[i])) continue;
+        W.npats = 0;
+        nout = cre_walk_closure_(&W, pat->nfa[i].u, pat->nfa[i].v, out, NULL, NULL);
+        if (flen + nout > fcap) {
+            fcap = (flen + nout) * 2;
+            fol = realloc(fol, sizeof(*fol) * fcap);
+        }
+        memcpy(&fol[flen], out, sizeof(*out) * nout);
+        flen += nout;
+        if (alen + W.npats > acap) {
+            acap = (alen + W.npats) * 2;
+            fac = realloc(fac, sizeof(*fac) * acap);
+        }
+        for (j = 0; j < W.npats; ++j) {
+            fac[alen++] = W.pats[j];
+            pmark[W.pats[j]] = false;
+        }
+    }
+
+    // the first SET nodes (and patterns matching the empty string) come from the start
+    W.npats = 0;
+    int nfirst = cre_walk_closure_(&W, pat->nfa_start, -1, out, NULL, NULL);
+    d->nnull = W.npats;
+    d->null = malloc(sizeof(*d->null) * (W.npats + 1));
+    for (j = 0; j < W.npats; ++j) {
+        d->null[j] = W.pats[j];
+        pmark[W.pats[j]] = false;
+    }
+    qsort(d->null, d->nnull, sizeof(*d->null), cre_dfa_cmp_);
+    free(W.pats);
+    free(pmark);
+    W.pats = NULL;
+    cre_walk_free_(&W);
+
+    if (!reverse) {
+        d->foloff = foloff;
+        d->fol = fol;
+        d->facoff = facoff;
+        d->fac = fac;
+        d->nent = 1;
+        d->entoff = malloc(sizeof(*d->entoff) * 2);
+        d->entoff[0] = 0;
+        d->entoff[1] = nfirst;
+        d->ent = malloc(sizeof(*d->ent) * (nfirst + 1));
+        memcpy(d->ent, out, sizeof(*out) * nfirst);
+    } else {
+        // reverse the follow lists (i.e. 'n' follows 'm' becomes 'm' follows 'n')
+        d->foloff = calloc(N + 2, sizeof(*d->foloff));
+        d->fol = malloc(sizeof(*d->fol) * (flen + 1));
+        for (i = 0; i < flen; ++i) {
+            d->foloff[fol[i] + 2]++;
+        }
+        for (i = 0; i < N; ++i) {
+            d->foloff[i + 2] += d->foloff[i + 1];
+        }
+        for (i = 0; i < N; ++i) {
+            for (k = foloff[i]; k < foloff[i + 1]; ++k) {
+                d->fol[d->foloff[fol[k] + 1]++] = i;
+            }
+        }
+
+        // a match may start at any of the first SET nodes
+        bool* first = calloc(N + 1, sizeof(*first));
+        for (i = 0; i < nfirst; ++i) {
+            first[out[i]] = true;
+        }
+        d->facoff = malloc(sizeof(*d->facoff) * (N + 1));
+        d->fac = malloc(sizeof(*d->fac) * (N + 1));
+        for (i = k = 0; i <= N; ++i) {
+            d->facoff[i] = k;
+            if (i < N && first[i]) d->fac[k++] = 0;
+        }
+        free(first);
+
+        // entries: the SET nodes that can end a match of each pattern
+        d->nent = P;
+        d->entoff = calloc(P + 2, sizeof(*d->entoff));
+        d->ent = malloc(sizeof(*d->ent) * (alen + 1));
+        for (i = 0; i < alen; ++i) {
+            d->entoff[fac[i] + 2]++;
+        }
+        for (i = 0; i < P; ++i) {
+            d->entoff[i + 2] += d->entoff[i + 1];
+        }
+        for (i = 0; i < N; ++i) {
+            for (k = facoff[i]; k < facoff[i + 1]; ++k) {
+                d->ent[d->entoff[fac[k] + 1]++] = i;
+            }
+        }
+        free(foloff);
+        free(fol);
+        free(facoff);
+        free(fac);
+    }
+    free(out);
+
+    // states
+    d->states_cap = 16;
+    d->soff = malloc(sizeof(*d->soff) * (d->states_cap + 1));
+    d->aoff = malloc(sizeof(*d->aoff) * (d->states_cap + 1));
+    d->soff[0] = d->aoff[0] = 0;
+    d->snodes_cap = d->apats_cap = 64;
+    d->snodes = malloc(sizeof(*d->snodes) * d->snodes_cap);
+    d->apats = malloc(sizeof(*d->apats) * d->apats_cap);
+    d->trans = malloc(sizeof(*d->trans) * d->states_cap * d->ncls);
+    d->start = malloc(sizeof(*d->start) * (2 * d->nent + 1));
+    for (i = 0; i < 2 * d->nent; ++i) {
+        d->start[i] = -1;
+    }
+    d->eoi = d->words ? malloc(sizeof(*d->eoi) * d->states_cap) : NULL;
+    d->tab_cap = 64;
+    d->tab = malloc(sizeof(*d->tab) * d->tab_cap);
+    for (i = 0; i < d->tab_cap; ++i) {
+        d->tab[i] = -1;
+    }
+    d->visits = NULL;
+    d->mark = calloc(N + 1, sizeof(*d->mark));
+    d->list = malloc(sizeof(*d->list) * (N + 1));
+    // NOTE: patterns that match before the last byte (see 'soff') are 'P + p'
+    d->pmark = calloc(2 * P + 1, sizeof(*d->pmark));
+    d->plist = malloc(sizeof(*d->plist) * (2 * P + 1));
+    d->cmark = calloc(N + 1, sizeof(*d->cmark));
+    d->clist = malloc(sizeof(*d->clist) * (N + 1));
+}
+
+void
+cre_dfa_free(cre_dfa* d) {
+    free(d->foloff);
+    free(d->fol);
+    free(d->facoff);
+    free(d->fac);
+    free(d->entoff);
+    free(d->ent);
+    free(d->null);
+    free(d->soff);
+    free(d->snodes);
+    free(d->aoff);
+    free(d->apats);
+    free(d->trans);
+    free(d->start);
+    free(d->tab);
+    free(d->mark);
+    free(d->list);
+    free(d->pmark);
+    free(d->plist);
+    free(d->cmark);
+    free(d->clist);
+    free(d->eoi);
+    free(d->visits);
+}
+
+void
+cre_dfa_memory_usage(cre_dfa* d, cre_mem* res) {
+    size_t N = d->pat->nfa_len, P = d->pat->npats, S = d->states_cap;
+    memset(res, 0, sizeof(*res));
+    res->classes = sizeof(d->cls);
+    // follow and entry lists, which are made up front
+    res->dfa = sizeof(int) * ((N + 2) + d->foloff[N] + (N + 1) + d->facoff[N] + (d->nent + 2) + d->entoff[d->nent] + (d->nnull + 1));
+    // states (and the room for more of them), which grow while searching
+    res->dfa += sizeof(int) * (2 * (S + 1) + d->snodes_cap + d->apats_cap + S * d->ncls + (2 * d->nent + 1) + d->tab_cap);
+    if (d->words) res->dfa += sizeof(*d->eoi) * S;
+    if (d->visits) res->dfa += sizeof(*d->visits) * S;
+    res->scratch = (sizeof(bool) + sizeof(int)) * (2 * (N + 1) + (2 * P + 1));
+    cre_mem_total_(res);
+}
+
+// hash a state's nodes and patterns
+static uint64_t
+cre_dfa_hash_(const int* nodes, int n, const int* pats, int np) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    int i;
+    for (i = 0; i < n; ++i) {
+        h = (h ^ (uint64_t)nodes[i]) * 0x100000001b3ULL;
+    }
+    h = (h ^ 0xff) * 0x100000001b3ULL;
+    for (i = 0; i < np; ++i) {
+        h = (h ^ (uint64_t)pats[i]) * 0x100000001b3ULL;
+    }
+    return h ^ (h >> 31);
+}
+
+// decide the word boundaries in 'nodes' (the nodes of a state), given whether the position
+//   is a word boundary, writing the nodes at the position (the ones in 'nodes', and the ones
+//   reached from word boundaries that hold) to 'd->clist' and returning how many there are
+// NOTE: patterns that match here are added to 'd->plist' (as 'P + p', see 'soff')
+static int
+cre_dfa_bound_(cre_dfa* d, const int* nodes, int len, bool bound, int* np) {
+    int N = d->pat->nfa_len, P = d->pat->npats, n = 0, i, j;
+    for (i = 0; i < len; ++i) {
+        if (nodes[i] < N) {
+            d->cmark[nodes[i]] = true;
+            d->clist[n++] = nodes[i];
+        }
+    }
+    // NOTE: 'n' grows, since word boundaries may lead to more of them
+    for (i = 0; i < n; ++i) {
+        int x = d->clist[i];
+        if (!cre_node_isb_(&d->pat->nfa[x]) || !cre_node_holds_(&d->pat->nfa[x], bound)) continue;
+        for (j = d->foloff[x]; j < d->foloff[x + 1]; ++j) {
+            if (!d->cmark[d->fol[j]]) {
+                d->cmark[d->fol[j]] = true;
+                d->clist[n++] = d->fol[j];
+            }
+        }
+        for (j = d->facoff[x]; j < d->facoff[x + 1]; ++j) {
+            int p = P + d->fac[j];
+            if (!d->pmark[p]) {
+                d->pmark[p] = true;
+                d->plist[(*np)++] = p;
+            }
+        }
+    }
+    for (i = 0; i < n; ++i) {
+        d->cmark[d->clist[i]] = false;
+    }
+    return n;
+}
+
+// find the patterns that match at the end of the input (or the start, for a reverse DFA)
+//   in state 's', writing them to 'd->plist' and returning how many there are
+static int
+cre_dfa_final_(cre_dfa* d, int s) {
+    int N = d->pat->nfa_len, P = d->pat->npats, np = 0, i;
+    if (!d->words) return 0;
+    const int* nodes = &d->snodes[d->soff[s]];
+    int len = d->soff[s + 1] - d->soff[s];
+    // it is a word boundary if the last byte was a word character
+    cre_dfa_bound_(d, nodes, len, len > 0 && nodes[len - 1] == N, &np);
+    for (i = 0; i < np; ++i) {
+        d->pmark[d->plist[i]] = false;
+        d->plist[i] -= P;
+    }
+    return np;
+}
+
+// find (or add) the state with the nodes in 'd->list' and patterns in 'd->plist',
+//   returning -1 if there are too many states
+static int
+cre_dfa_add_(cre_dfa* d, int n, int np) {
+    int i;
+    qsort(d->list, n, sizeof(*d->list), cre_dfa_cmp_);
+    qsort(d->plist, np, sizeof(*d->plist), cre_dfa_cmp_);
+    uint64_t h = cre_dfa_hash_(d->list, n, d->plist, np);
+    int k = h & (d->tab_cap - 1);
+    while (d->tab[k] >= 0) {
+        int s = d->tab[k];
+        if (d->soff[s + 1] - d->soff[s] == n && d->aoff[s + 1] - d->aoff[s] == np
+         && memcmp(&d->snodes[d->soff[s]], d->list, sizeof(int) * n) == 0
+         && memcmp(&d->apats[d->aoff[s]], d->plist, sizeof(int) * np) == 0) {
+            return s;
+        }
+        k = (k + 1) & (d->tab_cap - 1);
+    }
+    if (d->nstates >= d->max_states) return -1;
+
+    // add a new state
+    int s = d->nstates++;
+    if (d->nstates > d->states_cap) {
+        d->states_cap *= 2;
+        d->soff = realloc(d->soff, sizeof(*d->soff) * (d->states_cap + 1));
+        d->aoff = realloc(d->aoff, sizeof(*d->aoff) * (d->states_cap + 1));
+        d->trans = realloc(d->trans, sizeof(*d->trans) * d->states_cap * d->ncls);
+        if (d->words) d->eoi = realloc(d->eoi, sizeof(*d->eoi) * d->states_cap);
+        if (d->visits) d->visits = realloc(d->visits, sizeof(*d->visits) * d->states_cap);
+    }
+    if (d->soff[s] + n > d->snodes_cap) {
+        d->snodes_cap = (d->soff[s] + n) * 2;
+        d->snodes = realloc(d->snodes, sizeof(*d->snodes) * d->snodes_cap);
+    }
+    if (d->aoff[s] + np > d->apats_cap) {
+        d->apats_cap = (d->aoff[s] + np) * 2;
+        d->apats = realloc(d->apats, sizeof(*d->apats) * d->apats_cap);
+    }
+    memcpy(&d->snodes[d->soff[s]], d->list, sizeof(int) * n);
+    memcpy(&d->apats[d->aoff[s]], d->plist, sizeof(int) * np);
+    d->soff[s + 1] = d->soff[s] + n;
+    d->aoff[s + 1] = d->aoff[s] + np;
+    for (i = 0; i < d->ncls; ++i) {
+        d->trans[s * d->ncls + i] = -1;
+    }
+    d->tab[k] = s;
+    if (d->words) d->eoi[s] = cre_dfa_final_(d, s) > 0;
+    if (d->visits) d->visits[s] = 0;
+
+    // keep the hash table at most half full
+    if (2 * d->nstates > d->tab_cap) {
+        d->tab_cap *= 2;
+        d->tab = realloc(d->tab, sizeof(*d->tab) * d->tab_cap);
+        for (i = 0; i < d->tab_cap; ++i) {
+            d->tab[i] = -1;
+        }
+        for (i = 0; i < d->nstates; ++i) {
+            uint64_t hi = cre_dfa_hash_(&d->snodes[d->soff[i]], d->soff[i + 1] - d->soff[i], &d->apats[d->aoff[i]], d->aoff[i + 1] - d->aoff[i]);
+            int j = hi & (d->tab_cap - 1);
+            while (d->tab[j] >= 0) j = (j + 1) & (d->tab_cap - 1);
+            d->tab[j] = i;
+        }
+    }
+    return s;
+}
+
+// add the nodes in 'nodes' to 'd->list' (skipping ones already in it)
+static int
+cre_dfa_addnodes_(cre_dfa* d, int n, const int* nodes, int len) {
+    int i;
+    for (i = 0; i < len; ++i) {
+        if (!d->mark[nodes[i]]) {
+            d->mark[nodes[i]] = true;
+            d->list[n++] = nodes[i];
+        }
+    }
+    return n;
+}
+
+// return the state for an entry, after a word character if 'word' (see 'cre_dfa_entry')
+static int
+cre_dfa_entry_w_(cre_dfa* d, int e, bool word) {
+    int k = word && d->words ? d->nent + e : e;
+    if (d->start[k] >= 0) return d->start[k];
+    int n = cre_dfa_addnodes_(d, 0, &d->ent[d->entoff[e]], d->entoff[e + 1] - d->entoff[e]), i;
+    for (i = 0; i < n; ++i) {
+        d->mark[d->list[i]] = false;
+    }
+    if (k != e) d->list[n++] = d->pat->nfa_len;
+    return d->start[k] = cre_dfa_add_(d, n, 0);
+}
+
+int
+cre_dfa_entry(cre_dfa* d, int e) {
+    return cre_dfa_entry_w_(d, e, false);
+}
+
+int
+cre_dfa_next(cre_dfa* d, int s, char c) {
+    unsigned char b = c;
+    int* t = &d->trans[s * d->ncls + d->cls[b]];
+    if (*t >= 0) return *t;
+
+    int N = d->pat->nfa_len, n = 0, np = 0, i, j;
+    const int* nodes = &d->snodes[d->soff[s]];
+    int len = d->soff[s + 1] - d->soff[s];
+    if (d->words) {
+        // first, decide the word boundaries before 'c' (since it is a word boundary if
+        //   'c' is a different kind of character than the last one)
+        len = cre_dfa_bound_(d, nodes, len, (len > 0 && nodes[len - 1] == N) != cre_isword_(b), &np);
+        nodes = d->clist;
+    }
+
+    // follow each node that matches 'c'
+    for (i = 0; i < len; ++i) {
+        int x = nodes[i];
+        if (d->pat->nfa[x].kind != cre_SET || !d->pat->nfa[x].set[b]) continue;
+        n = cre_dfa_addnodes_(d, n, &d->fol[d->foloff[x]], d->foloff[x + 1] - d->foloff[x]);
+        for (j = d->facoff[x]; j < d->facoff[x + 1]; ++j) {
+            int p = d->fac[j];
+            if (!d->pmark[p]) {
+                d->pmark[p] = true;
+                d->plist[np++] = p;
+            }
+        }
+    }
+    if (!d->reverse) {
+        // every position may start a match too
+        n = cre_dfa_addnodes_(d, n, &d->ent[d->entoff[0]], d->entoff[1] - d->entoff[0]);
+    }
+    for (i = 0; i < n; ++i) {
+        d->mark[d->list[i]] = false;
+    }
+    if (d->words && cre_isword_(b)) d->list[n++] = N;
+    for (i = 0; i < np; ++i) {
+        d->pmark[d->plist[i]] = false;
+    }
+
+    int r = cre_dfa_add_(d, n, np);
+    // NOTE: adding a state may have moved the transition table
+    if (r >= 0) d->trans[s * d->ncls + d->cls[b]] = r;
+    return r;
+}
+
+int
+cre_dfa_search(cre_dfa* d, const char* src, size_t len, const cre_budget* budget, size_t* end) {
+    size_t n = len, i;
+    bool trunc = false;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+    int s = cre_dfa_entry(d, 0);
+    if (s < 0) return cre_BUDGET;
+    if (d->nnull > 0 && n > 0) {
+        // matches the empty string, so everything matches (see 'cre_sim_search')
+        *end = 1;
+        return cre_MATCH;
+    }
+    for (i = 0; i < n; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            int res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) return res;
+        }
+        int t = d->trans[s * d->ncls + d->cls[(unsigned char)src[i]]];
+        if (t < 0) {
+            if (budget && budget->max_memory) {
+                // it may add a state, so stop if it has already grown too big
+                cre_mem m;
+                cre_dfa_memory_usage(d, &m);
+                if (m.total > budget->max_memory) return cre_BUDGET;
+            }
+            if ((t = cre_dfa_next(d, s, src[i])) < 0) return cre_BUDGET;
+        }
+        s = t;
+        if (d->aoff[s + 1] > d->aoff[s]) {
+            *end = i + 1;
+            return cre_MATCH;
+        }
+    }
+    if (trunc) return cre_BUDGET;
+    if (d->words && n > 0 && d->eoi[s]) {
+        // a word boundary at the end completes a match
+        *end = n;
+        return cre_MATCH;
+    }
+    return cre_NOMATCH;
+}
+
+int
+cre_dfa_profile(cre_dfa* d, const char* src, size_t len, const cre_budget* budget) {
+    size_t i;
+    if (!d->visits) d->visits = calloc(d->states_cap, sizeof(*d->visits));
+    int s = cre_dfa_entry(d, 0);
+    if (s < 0) return cre_BUDGET;
+    d->visits[s]++;
+    for (i = 0; i < len; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            int res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) return res;
+        }
+        int t = d->trans[s * d->ncls + d->cls[(unsigned char)src[i]]];
+        if (t < 0 && (t = cre_dfa_next(d, s, src[i])) < 0) return cre_BUDGET;
+        s = t;
+        d->visits[s]++;
+    }
+    return cre_NOMATCH;
+}
+
+// state and how many times it was entered, for sorting
+struct cre_dfa_hot_ {
+    uint64_t n;
+    int s;
+};
+
+static int
+cre_dfa_hot_cmp_(const void* a, const void* b) {
+    const struct cre_dfa_hot_* x = a;
+    const struct cre_dfa_hot_* y = b;
+    // most entered first, then in order
+    if (x->n != y->n) return x->n > y->n ? -1 : 1;
+    return (x->s > y->s) - (x->s < y->s);
+}
+
+void
+cre_dfa_relayout(cre_dfa* d) {
+    int S = d->nstates, C = d->ncls, i, j;
+    if (!d->visits || S <= 0) return;
+    struct cre_dfa_hot_* hot = malloc(sizeof(*hot) * S);
+    for (i = 0; i < S; ++i) {
+        hot[i].n = d->visits[i];
+        hot[i].s = i;
+    }
+    qsort(hot, S, sizeof(*hot), cre_dfa_hot_cmp_);
+    // 'to[s]' is the new number of state 's'
+    int* to = malloc(sizeof(*to) * S);
+    for (i = 0; i < S; ++i) {
+        to[hot[i].s] = i;
+    }
+
+    // copy each state's tables over in the new order
+    int* soff = malloc(sizeof(*soff) * (d->states_cap + 1));
+    int* aoff = malloc(sizeof(*aoff) * (d->states_cap + 1));
+    int* snodes = malloc(sizeof(*snodes) * d->snodes_cap);
+    int* apats = malloc(sizeof(*apats) * d->apats_cap);
+    int* trans = malloc(sizeof(*trans) * d->states_cap * C);
+    bool* eoi = d->words ? malloc(sizeof(*eoi) * d->states_cap) : NULL;
+    uint64_t* visits = malloc(sizeof(*visits) * d->states_cap);
+    soff[0] = aoff[0] = 0;
+    for (i = 0; i < S; ++i) {
+        int s = hot[i].s, n = d->soff[s + 1] - d->soff[s], np = d->aoff[s + 1] - d->aoff[s];
+        memcpy(&snodes[soff[i]], &d->snodes[d->soff[s]], sizeof(*snodes) * n);
+        memcpy(&apats[aoff[i]], &d->apats[d->aoff[s]], sizeof(*apats) * np);
+        soff[i + 1] = soff[i] + n;
+        aoff[i + 1] = aoff[i] + np;
+        for (j = 0; j < C; ++j) {
+            int t = d->trans[s * C + j];
+            trans[i * C + j] = t >= 0 ? to[t] : -1;
+        }
+        if (eoi) eoi[i] = d->eoi[s];
+        visits[i] = d->visits[s];
+    }
+    free(d->soff);
+    free(d->aoff);
+    free(d->snodes);
+    free(d->apats);
+    free(d->trans);
+    free(d->eoi);
+    free(d->visits);
+    d->soff = soff;
+    d->aoff = aoff;
+    d->snodes = snodes;
+    d->apats = apats;
+    d->trans = trans;
+    d->eoi = eoi;
+    d->visits = visits;
+
+    // renumber the states that are referred to elsewhere
+    // NOTE: the hash table is by the states' nodes, so only the numbers in it change
+    for (i = 0; i < 2 * d->nent; ++i) {
+        if (d->start[i] >= 0) d->start[i] = to[d->start[i]];
+    }
+    for (i = 0; i < d->tab_cap; ++i) {
+        if (d->tab[i] >= 0) d->tab[i] = to[d->tab[i]];
+    }
+    free(to);
+    free(hot);
+}
+
+// build every state of a forward DFA, by following each byte class from each state,
+//   returning whether there weren't too many
+static bool
+cre_dfa_complete_(cre_dfa* d) {
+    char rep[256];
+    int c, s;
+    for (c = 255; c >= 0; --c) {
+        rep[d->cls[c]] = c;
+    }
+    if (cre_dfa_entry(d, 0) < 0) return false;
+    for (s = 0; s < d->nstates; ++s) {
+        for (c = 0; c < d->ncls; ++c) {
+            if (cre_dfa_next(d, s, rep[c]) < 0) return false;
+        }
+    }
+    return true;
+}
+
+
+// set a simulator (for the same pattern) to the SET nodes of forward DFA state 's'
+// NOTE: this is the state the simulator is in after feeding a byte and then starting a
+//         new match attempt, so the search can continue with the simulator from there
+static void
+cre_dfa_tosim_(cre_dfa* d, int s, cre_sim* sim) {
+    int i;
+    memset(sim->in, 0, sizeof(*sim->in) * d->pat->nfa_len);
+    sim->word = false;
+    for (i = d->soff[s]; i < d->soff[s + 1]; ++i) {
+        if (d->snodes[i] < d->pat->nfa_len) {
+            sim->in[d->snodes[i]] = true;
+        } else {
+            sim->word = true;
+        }
+    }
+}
+
+
+//// IMPL: cre_bsim ////
+
+// return whether a bitset simulator can be made for a pattern
+static bool
+cre_bsim_ok_(cre_pat* pat) {
+    return pat->nfa_len <= cre_BSIM_MAX_NODES && !cre_pat_words_(pat);
+}
+
+char*
+cre_bsim_init(cre_bsim* b, cre_pat* pat) {
+    int N = pat->nfa_len, i, j, k, c;
+    if (cre_pat_words_(pat)) return strdup("patterns with word boundaries can't use a bitset simulator");
+    if (N > cre_BSIM_MAX_NODES) {
+        char* err = malloc(80);
+        snprintf(err, 80, "pattern has %d nodes, and a bitset simulator is made for at most %d", N, cre_BSIM_MAX_NODES);
+        return err;
+    }
+    size_t W = ((size_t)N + 63) / 64;
+    b->pat = pat;
+    b->nwords = W;
+
+    // the follow lists of a forward DFA are what it needs, as bitsets
+    cre_dfa d;
+    cre_dfa_init(&d, pat, false, 1);
+    memcpy(b->cls, d.cls, sizeof(b->cls));
+    b->ncls = d.ncls;
+    b->cmask = calloc((size_t)b->ncls * W, sizeof(*b->cmask));
+    for (i = 0; i < N; ++i) {
+        if (pat->nfa[i].kind != cre_SET) continue;
+        for (c = 0; c < 256; ++c) {
+            if (pat->nfa[i].set[c]) b->cmask[(size_t)b->cls[c] * W + i / 64] |= 1ULL << (i % 64);
+        }
+    }
+    int nrows = 0;
+    b->row = malloc(sizeof(*b->row) * N);
+    for (i = 0; i < N; ++i) {
+        b->row[i] = pat->nfa[i].kind == cre_SET ? nrows++ : -1;
+    }
+    b->lo = malloc(sizeof(*b->lo) * (nrows + 1));
+    b->hi = malloc(sizeof(*b->hi) * (nrows + 1));
+    b->fol = calloc((size_t)nrows * W + 1, sizeof(*b->fol));
+    b->ent = calloc(W, sizeof(*b->ent));
+    b->acc = calloc(W, sizeof(*b->acc));
+    for (i = 0; i < N; ++i) {
+        int r = b->row[i];
+        if (r < 0) continue;
+        uint64_t* f = &b->fol[(size_t)r * W];
+        b->lo[r] = W;
+        b->hi[r] = 0;
+        for (j = d.foloff[i]; j < d.foloff[i + 1]; ++j) {
+            k = d.fol[j];
+            f[k / 64] |= 1ULL << (k % 64);
+            if (k / 64 < b->lo[r]) b->lo[r] = k / 64;
+            if (k / 64 + 1 > b->hi[r]) b->hi[r] = k / 64 + 1;
+        }
+        if (b->lo[r] > b->hi[r]) b->lo[r] = b->hi[r];
+        if (d.facoff[i + 1] > d.facoff[i]) b->acc[i / 64] |= 1ULL << (i % 64);
+    }
+    for (j = d.entoff[0]; j < d.entoff[1]; ++j) {
+        k = d.ent[j];
+        b->ent[k / 64] |= 1ULL << (k % 64);
+    }
+    b->null = d.nnull > 0;
+    cre_dfa_free(&d);
+
+    b->in = malloc(sizeof(*b->in) * W);
+    b->tmp = malloc(sizeof(*b->tmp) * W);
+    cre_bsim_reset(b);
+    return NULL;
+}
+
+void
+cre_bsim_free(cre_bsim* b) {
+    free(b->cmask);
+    free(b->row);
+    free(b->lo);
+    free(b->hi);
+    free(b->fol);
+    free(b->ent);
+    free(b->acc);
+    free(b->in);
+    free(b->tmp);
+}
+
+void
+cre_bsim_reset(cre_bsim* b) {
+    memcpy(b->in, b->ent, sizeof(*b->in) * b->nwords);
+    b->nbytes = b->nsteps = 0;
+}
+
+// return whether no match attempt is in progress (i.e. it is only in the entry nodes)
+static bool
+cre_bsim_idle_(cre_bsim* b) {
+    return memcmp(b->in, b->ent, sizeof(*b->in) * b->nwords) == 0;
+}
+
+bool
+cre_bsim_feedc(cre_bsim* b, char c) {
+    int W = b->nwords, i, j;
+    const uint64_t* cm = &b->cmask[(size_t)b->cls[(unsigned char)c] * W];
+    bool res = b->null;
+
+    // every position may start a match, and each SET node that matches 'c' adds the ones
+    //   that follow it
+    // NOTE: the inner loop is over plain words (and only the ones that may be nonzero), so
+    //         that compilers vectorize it for whatever the target has (e.g. AVX2)
+    uint64_t* next = b->tmp;
+    memcpy(next, b->ent, sizeof(*next) * W);
+    for (i = 0; i < W; ++i) {
+        uint64_t m = b->in[i] & cm[i];
+        if (m & b->acc[i]) res = true;
+        while (m) {
+            int r = b->row[64 * i + __builtin_ctzll(m)];
+            const uint64_t* f = &b->fol[(size_t)r * W];
+            for (j = b->lo[r]; j < b->hi[r]; ++j) {
+                next[j] |= f[j];
+            }
+            b->nsteps++;
+            m &= m - 1;
+        }
+    }
+    b->tmp = b->in;
+    b->in = next;
+    b->nbytes++;
+    return res;
+}
+
+int
+cre_bsim_search(cre_bsim* b, const char* src, size_t len, const cre_budget* budget, size_t* end) {
+    // how many bytes we can feed before running out of the byte budget
+    size_t n = len, i;
+    bool trunc = false;
+    int res;
+    if (budget && budget->max_bytes) {
+        size_t left = budget->max_bytes > b->nbytes ? budget->max_bytes - b->nbytes : 0;
+        if (n > left) {
+            n = left;
+            trunc = true;
+        }
+    }
+    for (i = 0; i < n; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(budget, b->nsteps);
+            if (res != cre_NOMATCH) return res;
+        }
+        if (cre_bsim_feedc(b, src[i])) {
+            *end = i + 1;
+            return cre_MATCH;
+        }
+    }
+    if (budget) {
+        res = cre_budget_check_(budget, b->nsteps);
+        if (res != cre_NOMATCH) return res;
+    }
+    return trunc ? cre_BUDGET : cre_NOMATCH;
+}
+
+void
+cre_bsim_memory_usage(cre_bsim* b, cre_mem* res) {
+    int N = b->pat->nfa_len, nrows = 0, i;
+    for (i = 0; i < N; ++i) {
+        if (b->row[i] >= 0) nrows++;
+    }
+    memset(res, 0, sizeof(*res));
+    res->classes = sizeof(b->cls) + sizeof(*b->cmask) * b->ncls * b->nwords;
+    res->nfa = sizeof(*b->row) * N + (sizeof(*b->lo) + sizeof(*b->hi)) * (nrows + 1) + sizeof(*b->fol) * ((size_t)nrows * b->nwords + 1)
+             + 2 * sizeof(*b->ent) * b->nwords;
+    res->scratch = 2 * sizeof(*b->in) * b->nwords;
+    cre_mem_total_(res);
+}
+
+
+//// IMPL: cre_pdfa ////
+
+char*
+cre_pdfa_init(cre_pdfa* p, cre_pat* pat, int max_states, const char* src, size_t len) {
+    int S, C, i, j;
+    cre_dfa d;
+    cre_dfa_init(&d, pat, false, max_states);
+    if ((len > 0 && cre_dfa_profile(&d, src, len, NULL) != cre_NOMATCH) || !cre_dfa_complete_(&d)) {
+        char* err = malloc(64);
+        snprintf(err, 64, "DFA has more than %d states", d.max_states);
+        cre_dfa_free(&d);
+        return err;
+    }
+    // NOTE: after this, the states that were entered come first
+    if (len > 0) cre_dfa_relayout(&d);
+    S = d.nstates;
+    C = d.ncls;
+
+    memcpy(p->cls, d.cls, sizeof(p->cls));
+    p->ncls = C;
+    p->ndense = S;
+    if (len > 0) {
+        for (p->ndense = 0; p->ndense < S && d.visits[p->ndense] > 0; ++p->ndense) {}
+    }
+    p->nsparse = S - p->ndense;
+
+    // number each state, and find how wide the numbers need to be
+    uint32_t* id = malloc(sizeof(*id) * S);
+    for (i = 0; i < S; ++i) {
+        id[i] = i < p->ndense ? (uint32_t)i * C : (uint32_t)p->ndense * C + (i - p->ndense);
+    }
+    uint64_t nids = (uint64_t)p->ndense * C + p->nsparse;
+    p->width = nids <= 0x100 ? 1 : nids <= 0x10000 ? 2 : 4;
+
+    p->dense = malloc((size_t)p->width * p->ndense * C + 1);
+    for (i = 0; i < p->ndense * C; ++i) {
+        uint32_t t = id[d.trans[i]];
+        if (p->width == 1) {
+            ((uint8_t*)p->dense)[i] = t;
+        } else if (p->width == 2) {
+            ((uint16_t*)p->dense)[i] = t;
+        } else {
+            ((uint32_t*)p->dense)[i] = t;
+        }
+    }
+
+    // a sparse row has a run wherever the next class goes somewhere else
+    p->roff = malloc(sizeof(*p->roff) * (p->nsparse + 1));
+    p->roff[0] = 0;
+    for (j = 0; j < p->nsparse; ++j) {
+        const int* row = &d.trans[(p->ndense + j) * C];
+        p->roff[j + 1] = p->roff[j];
+        for (i = 0; i < C; ++i) {
+            if (i == C - 1 || row[i + 1] != row[i]) p->roff[j + 1]++;
+        }
+    }
+    p->rhi = malloc(sizeof(*p->rhi) * (p->roff[p->nsparse] + 1));
+    p->rto = malloc(sizeof(*p->rto) * (p->roff[p->nsparse] + 1));
+    for (j = 0; j < p->nsparse; ++j) {
+        const int* row = &d.trans[(p->ndense + j) * C];
+        int r = p->roff[j];
+        for (i = 0; i < C; ++i) {
+            if (i == C - 1 || row[i + 1] != row[i]) {
+                p->rhi[r] = i;
+                p->rto[r++] = id[row[i]];
+            }
+        }
+    }
+
+    size_t nw = (nids + 63) / 64;
+    p->acc = calloc(nw, sizeof(*p->acc));
+    p->eoi = calloc(nw, sizeof(*p->eoi));
+    for (i = 0; i < S; ++i) {
+        if (d.aoff[i + 1] > d.aoff[i]) p->acc[id[i] / 64] |= 1ULL << (id[i] % 64);
+        if (d.words && d.eoi[i]) p->eoi[id[i] / 64] |= 1ULL << (id[i] % 64);
+    }
+    p->start = id[d.start[0]];
+    p->null = d.nnull > 0;
+    free(id);
+    cre_dfa_free(&d);
+    return NULL;
+}
+
+void
+cre_pdfa_free(cre_pdfa* p) {
+    free(p->dense);
+    free(p->roff);
+    free(p->rhi);
+    free(p->rto);
+    free(p->acc);
+    free(p->eoi);
+}
+
+// follow the transition from state 's' on byte class 'k'
+static inline uint32_t
+cre_pdfa_next_(const cre_pdfa* p, uint32_t s, int k) {
+    uint32_t nd = (uint32_t)p->ndense * p->ncls;
+    if (s < nd) {
+        if (p->width == 1) return ((const uint8_t*)p->dense)[s + k];
+        if (p->width == 2) return ((const uint16_t*)p->dense)[s + k];
+        return ((const uint32_t*)p->dense)[s + k];
+    }
+    // NOTE: sparse rows are for states that are rarely entered, so a scan is fine
+    int r = p->roff[s - nd];
+    while (p->rhi[r] < k) ++r;
+    return p->rto[r];
+}
+
+int
+cre_pdfa_search(const cre_pdfa* p, const char* src, size_t len, const cre_budget* budget, size_t* end) {
+    size_t n = len, i;
+    bool trunc = false;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+    if (p->null && n > 0) {
+        // matches the empty string, so everything matches (see 'cre_sim_search')
+        *end = 1;
+        return cre_MATCH;
+    }
+    uint32_t s = p->start;
+    for (i = 0; i < n; ++i) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            int res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) return res;
+        }
+        s = cre_pdfa_next_(p, s, p->cls[(unsigned char)src[i]]);
+        if ((p->acc[s / 64] >> (s % 64)) & 1) {
+            *end = i + 1;
+            return cre_MATCH;
+        }
+    }
+    if (trunc) return cre_BUDGET;
+    if (n > 0 && ((p->eoi[s / 64] >> (s % 64)) & 1)) {
+        // a word boundary at the end completes a match
+        *end = n;
+        return cre_MATCH;
+    }
+    return cre_NOMATCH;
+}
+
+void
+cre_pdfa_memory_usage(cre_pdfa* p, cre_mem* res) {
+    size_t nids = (size_t)p->ndense * p->ncls + p->nsparse, nr = p->roff[p->nsparse];
+    memset(res, 0, sizeof(*res));
+    res->classes = sizeof(p->cls);
+    res->dfa = (size_t)p->width * p->ndense * p->ncls + sizeof(*p->roff) * (p->nsparse + 1)
+             + (sizeof(*p->rhi) + sizeof(*p->rto)) * nr + 2 * sizeof(uint64_t) * ((nids + 63) / 64);
+    cre_mem_total_(res);
+}
+
+
+//// IMPL: cre_ovl ////
+
+void
+cre_ovl_init(cre_ovl* o, cre_pat* pat, int max_states) {
+    cre_dfa_init(&o->fwd, pat, false, max_states);
+    cre_dfa_init(&o->rev, pat, true, max_states);
+    o->ends = malloc(sizeof(*o->ends) * (pat->npats + 1));
+    o->mark = calloc(pat->npats + 1, sizeof(*o->mark));
+}
+
+void
+cre_ovl_free(cre_ovl* o) {
+    cre_dfa_free(&o->fwd);
+    cre_dfa_free(&o->rev);
+    free(o->ends);
+    free(o->mark);
+}
+
+void
+cre_ovl_memory_usage(cre_ovl* o, cre_mem* res) {
+    cre_mem m;
+    cre_dfa_memory_usage(&o->fwd, res);
+    cre_dfa_memory_usage(&o->rev, &m);
+    cre_mem_add_(res, &m);
+    res->scratch += (sizeof(*o->ends) + sizeof(*o->mark)) * (o->fwd.pat->npats + 1);
+    cre_mem_total_(res);
+}
+
+// returned by 'cre_ovl_back_' when 'fn' asks to stop
+#define cre_OVL_STOP 2
+
+// find where the matches of pattern 'p' that end at 'e' start, scanning backwards with the
+//   reverse DFA, and calling 'fn' for each (latest first), returning a 'cre_res' (or
+//   'cre_OVL_STOP' if 'fn' returned false)
+static int
+cre_ovl_back_(cre_ovl* o, const char* src, size_t len, int p, size_t e, cre_ovl_fn fn, void* ctx) {
+    cre_dfa* rev = &o->rev;
+    int P = rev->pat->npats, res = cre_NOMATCH, j;
+    size_t i, last = SIZE_MAX;
+    // NOTE: if the pattern matches the empty string, its empty match here was already
+    //         reported, so treat it as the last start
+    for (j = 0; j < o->fwd.nnull; ++j) {
+        if (o->fwd.null[j] == p) last = e;
+    }
+    int r = cre_dfa_entry_w_(rev, p, e < len && cre_isword_(src[e]));
+    if (r < 0) return cre_BUDGET;
+    for (i = e; i > 0; --i) {
+        int t = rev->trans[r * rev->ncls + rev->cls[(unsigned char)src[i - 1]]];
+        if (t < 0 && (t = cre_dfa_next(rev, r, src[i - 1])) < 0) return cre_BUDGET;
+        r = t;
+        // a match starts before the byte, or (from a word boundary) just after it
+        bool after = false, before = false;
+        for (j = rev->aoff[r]; j < rev->aoff[r + 1]; ++j) {
+            if (rev->apats[j] >= P) after = true;
+            else before = true;
+        }
+        if (after && last != i) {
+            res = cre_MATCH;
+            last = i;
+            if (!fn(ctx, p, i, e)) return cre_OVL_STOP;
+        }
+        if (before) {
+            res = cre_MATCH;
+            last = i - 1;
+            if (!fn(ctx, p, i - 1, e)) return cre_OVL_STOP;
+        }
+        // NOTE: the only node may be the one for the last byte being a word character
+        int nn = rev->soff[r + 1] - rev->soff[r];
+        if (nn == 0 || (nn == 1 && rev->snodes[rev->soff[r]] == rev->pat->nfa_len)) return res;
+    }
+    if (cre_dfa_final_(rev, r) > 0 && last != 0) {
+        // a word boundary at the start
+        res = cre_MATCH;
+        if (!fn(ctx, p, 0, e)) return cre_OVL_STOP;
+    }
+    return res;
+}
+
+int
+cre_ovl_search(cre_ovl* o, const char* src, size_t len, const cre_budget* budget, cre_ovl_fn fn, void* ctx) {
+    cre_dfa* fwd = &o->fwd;
+    int P = fwd->pat->npats;
+    size_t n = len, e;
+    bool trunc = false, any = false;
+    int res, j, k;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+    int* ends = o->ends;
+    bool* mark = o->mark;
+    int s = cre_dfa_entry(fwd, 0);
+    res = s < 0 ? cre_BUDGET : cre_NOMATCH;
+    for (e = 0; res == cre_NOMATCH && e <= n; ++e) {
+        if (budget && e % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) break;
+        }
+        if (e > 0) {
+            int t = fwd->trans[s * fwd->ncls + fwd->cls[(unsigned char)src[e - 1]]];
+            if (t < 0 && (t = cre_dfa_next(fwd, s, src[e - 1])) < 0) {
+                res = cre_BUDGET;
+                break;
+            }
+            s = t;
+        }
+        for (j = 0; j < fwd->nnull && res == cre_NOMATCH; ++j) {
+            // empty match
+            any = true;
+            if (!fn(ctx, fwd->null[j], e, e)) res = cre_MATCH;
+        }
+        if (res != cre_NOMATCH) break;
+
+        // matches that end here are in this state, and (from word boundaries) the next one
+        // NOTE: a pattern may be in both, so they are deduplicated as they are added, and
+        //         there are at most 'P' of them
+        int ne = 0, t = -1;
+        if (fwd->words && e < len) {
+            t = fwd->trans[s * fwd->ncls + fwd->cls[(unsigned char)src[e]]];
+            if (t < 0 && (t = cre_dfa_next(fwd, s, src[e])) < 0) {
+                res = cre_BUDGET;
+                break;
+            }
+        }
+        for (j = fwd->aoff[s]; j < fwd->aoff[s + 1]; ++j) {
+            k = fwd->apats[j];
+            if (k < P && !mark[k]) mark[ends[ne++] = k] = true;
+        }
+        if (t >= 0) {
+            for (j = fwd->aoff[t]; j < fwd->aoff[t + 1]; ++j) {
+                k = fwd->apats[j] - P;
+                if (k >= 0 && !mark[k]) mark[ends[ne++] = k] = true;
+            }
+        } else if (fwd->words) {
+            int np = cre_dfa_final_(fwd, s);
+            for (j = 0; j < np; ++j) {
+                k = fwd->plist[j];
+                if (!mark[k]) mark[ends[ne++] = k] = true;
+            }
+        }
+        for (j = 0; j < ne; ++j) {
+            mark[ends[j]] = false;
+        }
+        // NOTE: the patterns in the state and in the next one are each sorted, so merge them
+        qsort(ends, ne, sizeof(*ends), cre_dfa_cmp_);
+
+        // scan backwards from here for where they start
+        for (j = 0; j < ne && res == cre_NOMATCH; ++j) {
+            int r = cre_ovl_back_(o, src, len, ends[j], e, fn, ctx);
+            if (r == cre_MATCH) {
+                any = true;
+            } else if (r == cre_OVL_STOP) {
+                res = cre_MATCH;
+            } else if (r != cre_NOMATCH) {
+                res = r;
+            }
+        }
+    }
+    if (res != cre_NOMATCH) return res;
+    if (trunc) return cre_BUDGET;
+    return any ? cre_MATCH : cre_NOMATCH;
+}
+
+
+//// IMPL: cre_ckpt ////
+
+void
+cre_ckpt_init(cre_ckpt* c, cre_pat* pat, size_t every) {
+    c->pat = pat;
+    c->every = every > 0 ? every : cre_CKPT_EVERY;
+    c->nfa = false;
+    cre_dfa_init(&c->dfa, pat, false, 0);
+    cre_sim_init(&c->sim, pat);
+    // NOTE: the last bit is whether the last byte was a word character
+    c->nwords = (pat->nfa_len + 1 + 63) / 64;
+    memset(&c->cur, 0, sizeof(c->cur));
+    memset(&c->old, 0, sizeof(c->old));
+}
+
+void
+cre_ckpt_free(cre_ckpt* c) {
+    cre_dfa_free(&c->dfa);
+    cre_sim_free(&c->sim);
+    free(c->cur.off);
+    free(c->cur.state);
+    free(c->cur.bits);
+    free(c->old.off);
+    free(c->old.state);
+    free(c->old.bits);
+}
+
+void
+cre_ckpt_memory_usage(cre_ckpt* c, cre_mem* res) {
+    cre_mem m;
+    cre_dfa_memory_usage(&c->dfa, res);
+    cre_sim_memory_usage(&c->sim, &m);
+    cre_mem_add_(res, &m);
+    // each checkpoint has an offset, and a DFA state or an NFA bitset
+    size_t each = sizeof(*c->cur.off) + sizeof(*c->cur.state) + (c->nfa ? sizeof(*c->cur.bits) * c->nwords : 0);
+    res->dfa += each * (c->cur.cap + c->old.cap);
+    cre_mem_total_(res);
+}
+
+// make room for at least 'len' checkpoints in 'L'
+static void
+cre_ckpt_grow_(cre_ckpt* c, struct cre_ckpt_list* L, size_t len) {
+    if (len <= L->cap) return;
+    L->cap = len < 8 ? 16 : 2 * len;
+    L->off = realloc(L->off, sizeof(*L->off) * L->cap);
+    L->state = realloc(L->state, sizeof(*L->state) * L->cap);
+    if (c->nfa) L->bits = realloc(L->bits, sizeof(*L->bits) * c->nwords * L->cap);
+}
+
+// set checkpoint 'k' of 'L' to the current state ('s' or the simulator)
+static void
+cre_ckpt_save_(cre_ckpt* c, struct cre_ckpt_list* L, size_t k, size_t off, int s) {
+    cre_ckpt_grow_(c, L, k + 1);
+    L->off[k] = off;
+    if (!c->nfa) {
+        L->state[k] = s;
+        return;
+    }
+    uint64_t* b = &L->bits[k * c->nwords];
+    int i;
+    memset(b, 0, sizeof(*b) * c->nwords);
+    for (i = 0; i < c->pat->nfa_len; ++i) {
+        if (c->sim.in[i] && cre_node_waits_(&c->pat->nfa[i])) b[i / 64] |= 1ULL << (i % 64);
+    }
+    if (c->sim.word) b[i / 64] |= 1ULL << (i % 64);
+}
+
+// copy checkpoint 'j' of 'A' to checkpoint 'k' of 'B'
+static void
+cre_ckpt_copy_(cre_ckpt* c, struct cre_ckpt_list* B, size_t k, struct cre_ckpt_list* A, size_t j) {
+    cre_ckpt_grow_(c, B, k + 1);
+    B->off[k] = A->off[j];
+    if (!c->nfa) {
+        B->state[k] = A->state[j];
+    } else {
+        memcpy(&B->bits[k * c->nwords], &A->bits[j * c->nwords], sizeof(*B->bits) * c->nwords);
+    }
+}
+
+// return whether the current state is the same as checkpoint 'k' of 'L'
+// NOTE: only SET nodes (and word boundaries) matter, since epsilon nodes are only passed
+//         through
+static bool
+cre_ckpt_same_(cre_ckpt* c, struct cre_ckpt_list* L, size_t k, int s) {
+    if (!c->nfa) return L->state[k] == s;
+    uint64_t* b = &L->bits[k * c->nwords];
+    int i;
+    for (i = 0; i < c->pat->nfa_len; ++i) {
+        bool x = c->sim.in[i] && cre_node_waits_(&c->pat->nfa[i]);
+        if (x != ((b[i / 64] >> (i % 64)) & 1)) return false;
+    }
+    return c->sim.word == ((b[i / 64] >> (i % 64)) & 1);
+}
+
+// make checkpoint 'k' of 'L' the current state, returning it (or setting the simulator)
+static int
+cre_ckpt_load_(cre_ckpt* c, struct cre_ckpt_list* L, size_t k) {
+    if (!c->nfa) return L->state[k];
+    uint64_t* b = &L->bits[k * c->nwords];
+    int i;
+    for (i = 0; i < c->pat->nfa_len; ++i) {
+        c->sim.in[i] = (b[i / 64] >> (i % 64)) & 1;
+    }
+    c->sim.word = (b[i / 64] >> (i % 64)) & 1;
+    return 0;
+}
+
+// switch from DFA states to NFA bitsets (when the DFA gets too big), converting every
+//   checkpoint, and the current state 's'
+// NOTE: nothing needs to be re-scanned (see 'cre_dfa_tosim_')
+static void
+cre_ckpt_tonfa_(cre_ckpt* c, int s) {
+    struct cre_ckpt_list* lists[2] = { &c->cur, &c->old };
+    int l;
+    size_t k;
+    c->nfa = true;
+    for (l = 0; l < 2; ++l) {
+        struct cre_ckpt_list* L = lists[l];
+        L->bits = realloc(L->bits, sizeof(*L->bits) * c->nwords * (L->cap + 1));
+        for (k = 0; k < L->len; ++k) {
+            cre_dfa_tosim_(&c->dfa, L->state[k], &c->sim);
+            cre_ckpt_save_(c, L, k, L->off[k], 0);
+        }
+    }
+    cre_dfa_tosim_(&c->dfa, s, &c->sim);
+}
+
+// feed a byte to the current state, returning whether a match ends after it
+static bool
+cre_ckpt_step_(cre_ckpt* c, int* s, char ch) {
+    if (!c->nfa) {
+        cre_dfa* d = &c->dfa;
+        int t = d->trans[*s * d->ncls + d->cls[(unsigned char)ch]];
+        if (t >= 0 || (t = cre_dfa_next(d, *s, ch)) >= 0) {
+            *s = t;
+            return d->aoff[t + 1] > d->aoff[t] || d->nnull > 0;
+        }
+        cre_ckpt_tonfa_(c, *s);
+    }
+    bool m = cre_sim_feedc(&c->sim, ch);
+    cre_sim_feedz(&c->sim, cre_START);
+    return m || c->sim.null;
+}
+
+// return whether a match ends at the end of the input (from a word boundary there)
+static bool
+cre_ckpt_end_(cre_ckpt* c, int s) {
+    if (!c->nfa) return c->dfa.words && c->dfa.eoi[s];
+    return cre_sim_feedz(&c->sim, cre_END);
+}
+
+// scan from the last current checkpoint until 'len', or until the state is the same as
+//   an old checkpoint (which means the rest of them are still valid), setting '*to' to
+//   where it stopped
+static int
+cre_ckpt_run_(cre_ckpt* c, const char* src, size_t len, const cre_budget* budget, cre_end_fn fn, void* ctx, size_t* to) {
+    struct cre_ckpt_list* L = &c->cur;
+    struct cre_ckpt_list* O = &c->old;
+    size_t j = 0, i = L->off[L->len - 1], last = i;
+    int s = cre_ckpt_load_(c, L, L->len - 1), res = cre_NOMATCH;
+    while (i < len) {
+        if (budget && i % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) break;
+        }
+        bool m = cre_ckpt_step_(c, &s, src[i++]);
+        if (m && fn) fn(ctx, i);
+
+        while (j < O->len && O->off[j] < i) j++;
+        if (j < O->len && O->off[j] == i && cre_ckpt_same_(c, O, j, s)) {
+            // back in sync, so keep the rest of the old checkpoints
+            for (; j < O->len; ++j) {
+                cre_ckpt_copy_(c, L, L->len++, O, j);
+            }
+            break;
+        }
+        if (i - last >= c->every) {
+            // NOTE: 'L->len' is kept up to date, since 'cre_ckpt_tonfa_' may convert it
+            cre_ckpt_save_(c, L, L->len++, i, s);
+            last = i;
+        }
+    }
+    // NOTE: even if it synced up right at the end, the range re-scanned includes 'len'
+    if (res == cre_NOMATCH && i == len && len > 0 && fn && cre_ckpt_end_(c, s)) fn(ctx, len);
+    O->len = 0;
+    *to = i;
+    return res;
+}
+
+int
+cre_ckpt_scan(cre_ckpt* c, const char* src, size_t len, const cre_budget* budget, cre_end_fn fn, void* ctx) {
+    int s = 0;
+    size_t to;
+    if (c->nfa) {
+        cre_sim_reset(&c->sim);
+    } else {
+        s = cre_dfa_entry(&c->dfa, 0);
+    }
+    c->old.len = 0;
+    cre_ckpt_save_(c, &c->cur, 0, 0, s);
+    c->cur.len = 1;
+    return cre_ckpt_run_(c, src, len, budget, fn, ctx, &to);
+}
+
+int
+cre_ckpt_edit(cre_ckpt* c, const char* src, size_t len, size_t pos, size_t old_len, size_t new_len, const cre_budget* budget, cre_end_fn fn, void* ctx, size_t* from, size_t* to) {
+    struct cre_ckpt_list* L = &c->cur;
+    struct cre_ckpt_list* O = &c->old;
+    size_t k = 0, i;
+    if (L->len == 0) {
+        *from = 0;
+        *to = len;
+        return cre_ckpt_scan(c, src, len, budget, fn, ctx);
+    }
+
+    // checkpoints up to the edit are still valid, and the ones after it are moved to
+    //   the old list (in the new offsets), to check against
+    O->len = 0;
+    for (i = 0; i < L->len; ++i) {
+        if (L->off[i] <= pos) {
+            k++;
+        } else if (L->off[i] >= pos + old_len) {
+            cre_ckpt_copy_(c, O, O->len, L, i);
+            O->off[O->len++] += new_len - old_len;
+        }
+    }
+    L->len = k;
+    *from = L->off[k - 1];
+    return cre_ckpt_run_(c, src, len, budget, fn, ctx, to);
+}
+
+
+//// IMPL: cre_srch ////
+
+// stop using the DFA (since it has too many states), and continue from DFA state 'st' (or
+//   the start, if 'st < 0') with the bitset simulator if the pattern allows it, and with the
+//   simulator otherwise
+static void
+cre_srch_nodfa_(cre_srch* s, int st) {
+    int i;
+    if (!s->has_bsim && cre_bsim_ok_(s->pat)) {
+        cre_bsim_init(&s->bsim, s->pat);
+        s->has_bsim = true;
+    }
+    if (s->has_bsim) {
+        s->engine = cre_ENGINE_BSIM;
+        if (st < 0) {
+            cre_bsim_reset(&s->bsim);
+            return;
+        }
+        // NOTE: without word boundaries, a DFA state is just its SET nodes
+        memset(s->bsim.in, 0, sizeof(*s->bsim.in) * s->bsim.nwords);
+        for (i = s->dfa.soff[st]; i < s->dfa.soff[st + 1]; ++i) {
+            s->bsim.in[s->dfa.snodes[i] / 64] |= 1ULL << (s->dfa.snodes[i] % 64);
+        }
+    } else {
+        s->engine = cre_ENGINE_SIM;
+        if (st >= 0) cre_dfa_tosim_(&s->dfa, st, &s->sim);
+    }
+}
+
+char*
+cre_srch_init(cre_srch* s, cre_pat* pat, int k) {
+    s->pat = pat;
+    s->approx = k >= 0;
+    if (s->approx) {
+        char* err = cre_apx_init(&s->apx, pat, k);
+        if (err) return err;
+    }
+
+    // use the DFA unless it explodes, and find a prefix to skip ahead to
+    cre_analysis a;
+    cre_pat_analyze(pat, &a);
+    // NOTE: approximate matches can start with anything
+    s->prefix_len = s->approx ? 0 : a.prefix_len;
+    memcpy(s->prefix, a.prefix, s->prefix_len);
+
+    cre_dfa_init(&s->dfa, pat, false, 0);
+    cre_sim_init(&s->sim, pat);
+    s->engine = cre_ENGINE_DFA;
+    s->has_bsim = false;
+    if (a.dfa_explodes) cre_srch_nodfa_(s, -1);
+    s->gen = (uint64_t)cre_now() ^ (uint64_t)(uintptr_t)s;
+    cre_srch_reset(s);
+    return NULL;
+}
+
+void
+cre_srch_free(cre_srch* s) {
+    if (s->approx) cre_apx_free(&s->apx);
+    cre_dfa_free(&s->dfa);
+    cre_sim_free(&s->sim);
+    if (s->has_bsim) cre_bsim_free(&s->bsim);
+}
+
+void
+cre_srch_memory_usage(cre_srch* s, cre_mem* res) {
+    cre_mem m;
+    cre_dfa_memory_usage(&s->dfa, res);
+    cre_sim_memory_usage(&s->sim, &m);
+    cre_mem_add_(res, &m);
+    if (s->has_bsim) {
+        cre_bsim_memory_usage(&s->bsim, &m);
+        cre_mem_add_(res, &m);
+    }
+    if (s->approx) {
+        res->nfa += sizeof(s->apx.masks);
+        res->scratch += sizeof(*s->apx.R) * (s->apx.k + 1);
+    }
+    if (s->prefix_len > 0) res->prefilter += sizeof(s->prefix);
+    cre_mem_total_(res);
+}
+
+void
+cre_srch_reset(cre_srch* s) {
+    int i;
+    s->nbytes = 0;
+    if (s->approx) cre_apx_reset(&s->apx);
+    cre_sim_reset(&s->sim);
+    if (s->has_bsim) cre_bsim_reset(&s->bsim);
+    s->nidle = 0;
+    for (i = 0; i < s->pat->nfa_len; ++i) {
+        if (s->sim.in[i] && cre_node_waits_(&s->pat->nfa[i])) s->nidle++;
+    }
+    if (s->engine == cre_ENGINE_DFA) {
+        s->s = cre_dfa_entry(&s->dfa, 0);
+        if (s->s < 0) cre_srch_nodfa_(s, -1);
+    }
+}
+
+// position in a chain of buffers
+struct cre_iov_ {
+    const struct iovec* iov;
+    int n;
+
+    // current buffer, offset in it, and the offset of the buffer (in the whole chain)
+    int k;
+    size_t i, base;
+
+};
+
+// move past the end of empty/finished buffers
+static void
+cre_iov_norm_(struct cre_iov_* C) {
+    while (C->k < C->n && C->i >= C->iov[C->k].iov_len) {
+        C->i -= C->iov[C->k].iov_len;
+        C->base += C->iov[C->k].iov_len;
+        C->k++;
+    }
+}
+
+// return whether 'lit' starts at 'C' (or, it matches until the end of the chain)
+static bool
+cre_iov_starts_(struct cre_iov_ C, const char* lit, int len) {
+    int j;
+    for (j = 0; j < len; ++j) {
+        cre_iov_norm_(&C);
+        if (C.k >= C.n) return true;
+        if (((const char*)C.iov[C.k].iov_base)[C.i++] != lit[j]) return false;
+    }
+    return true;
+}
+
+// return how many bytes after 'C' the next place 'lit' may start is (see 'cre_iov_starts_')
+static size_t
+cre_iov_find_(struct cre_iov_ C, const char* lit, int len) {
+    size_t d = 0;
+    while (true) {
+        cre_iov_norm_(&C);
+        if (C.k >= C.n) return d;
+        const char* src = C.iov[C.k].iov_base;
+        size_t left = C.iov[C.k].iov_len - C.i;
+        const char* p = memchr(src + C.i, lit[0], left);
+        if (!p) {
+            d += left;
+            C.i += left;
+            continue;
+        }
+        d += p - (src + C.i);
+        C.i = p - src;
+        if (cre_iov_starts_(C, lit, len)) return d;
+        d++;
+        C.i++;
+    }
+}
+
+// return whether no match attempt is in progress (so that the searcher may skip ahead)
+static bool
+cre_srch_idle_(cre_srch* s) {
+    if (s->engine == cre_ENGINE_DFA) return s->s == s->dfa.start[0] || (s->dfa.words && s->s == s->dfa.start[s->dfa.nent]);
+    if (s->engine == cre_ENGINE_BSIM) return cre_bsim_idle_(&s->bsim);
+    int i, n = 0;
+    for (i = 0; i < s->pat->nfa_len; ++i) {
+        if (s->sim.in[i] && cre_node_waits_(&s->pat->nfa[i])) n++;
+    }
+    return n == s->nidle;
+}
+
+// after skipping ahead while idle, keep whether the last byte skipped was a word character
+static void
+cre_srch_skipped_(cre_srch* s, bool word) {
+    if (s->engine == cre_ENGINE_DFA) {
+        int t = cre_dfa_entry_w_(&s->dfa, 0, word);
+        if (t >= 0) {
+            s->s = t;
+            return;
+        }
+        cre_srch_nodfa_(s, s->s);
+    }
+    s->sim.word = word;
+}
+
+// stop growing the DFA if it has gotten bigger than 'max' bytes, by continuing with a
+//   simulator (which doesn't grow) instead
+static void
+cre_srch_limit_(cre_srch* s, size_t max) {
+    cre_mem m;
+    cre_dfa_memory_usage(&s->dfa, &m);
+    if (m.total > max) cre_srch_nodfa_(s, s->s);
+}
+
+// feed a byte, returning whether a match ends after it
+static bool
+cre_srch_step_(cre_srch* s, char c) {
+    if (s->approx) return cre_apx_feedc(&s->apx, c) >= 0;
+    if (s->engine == cre_ENGINE_DFA) {
+        cre_dfa* d = &s->dfa;
+        int t = d->trans[s->s * d->ncls + d->cls[(unsigned char)c]];
+        if (t >= 0 || (t = cre_dfa_next(d, s->s, c)) >= 0) {
+            s->s = t;
+            return d->aoff[t + 1] > d->aoff[t] || d->nnull > 0;
+        }
+        // too many states, so continue without it
+        cre_srch_nodfa_(s, s->s);
+    }
+    if (s->engine == cre_ENGINE_BSIM) return cre_bsim_feedc(&s->bsim, c);
+    bool m = cre_sim_feedc(&s->sim, c);
+    cre_sim_feedz(&s->sim, cre_START);
+    return m || s->sim.null;
+}
+
+int
+cre_search_iov(cre_srch* s, const struct iovec* iov, int n, size_t from, const cre_budget* budget, size_t* end) {
+    struct cre_iov_ C = { iov, n, 0, from, 0 };
+    size_t left = SIZE_MAX, it;
+    int res;
+    if (budget && budget->max_bytes) {
+        left = budget->max_bytes > s->nbytes ? budget->max_bytes - s->nbytes : 0;
+    }
+    for (it = 0; ; ++it) {
+        cre_iov_norm_(&C);
+        if (C.k >= C.n) break;
+        if (left == 0) return cre_BUDGET;
+        if (budget && it % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(budget, s->sim.nsteps + (s->has_bsim ? s->bsim.nsteps : 0));
+            if (res != cre_NOMATCH) return res;
+            if (budget->max_memory && s->engine == cre_ENGINE_DFA) cre_srch_limit_(s, budget->max_memory);
+        }
+
+        if (s->prefix_len > 0 && cre_srch_idle_(s)) {
+            // nothing can match before the prefix does, so skip to it
+            size_t d = cre_iov_find_(C, s->prefix, s->prefix_len);
+            if (d > left) d = left;
+            if (d > 0) {
+                C.i += d;
+                left -= d;
+                s->nbytes += d;
+                if (s->sim.words) {
+                    struct cre_iov_ B = C;
+                    B.i--;
+                    cre_iov_norm_(&B);
+                    cre_srch_skipped_(s, cre_isword_(((const char*)B.iov[B.k].iov_base)[B.i]));
+                }
+                continue;
+            }
+        }
+
+        const char* src = C.iov[C.k].iov_base;
+        bool m = cre_srch_step_(s, src[C.i++]);
+        left--;
+        s->nbytes++;
+        if (m) {
+            *end = C.base + C.i;
+            return cre_MATCH;
+        }
+    }
+    return cre_NOMATCH;
+}
+
+
+// saved state of a streaming searcher, followed by the SET nodes it is in (as a bitset, with
+//   the last bit for whether the last byte was a word character) and the approximate
+//   matcher's state (if 'approx')
+// NOTE: 's' is only used if 'gen' is the same searcher, since DFA state numbers depend on
+//         the order the states were built in
+struct cre_srch_state_ {
+    uint64_t gen;
+    enum cre_engine engine;
+    int s;
+    uint64_t nbytes;
+};
+
+size_t
+cre_srch_state_size(cre_srch* s) {
+    size_t sz = sizeof(struct cre_srch_state_) + sizeof(uint64_t) * ((s->pat->nfa_len + 1 + 63) / 64);
+    if (s->approx) sz += sizeof(*s->apx.R) * (s->apx.k + 1);
+    return sz;
+}
+
+void
+cre_srch_save(cre_srch* s, void* state) {
+    struct cre_srch_state_* st = state;
+    uint64_t* b = (uint64_t*)(st + 1);
+    int nw = (s->pat->nfa_len + 1 + 63) / 64, i;
+    memset(st, 0, sizeof(*st));
+    st->gen = s->gen;
+    st->engine = s->engine;
+    st->s = s->s;
+    st->nbytes = s->nbytes;
+    memset(b, 0, sizeof(*b) * nw);
+    if (s->engine == cre_ENGINE_SIM) {
+        for (i = 0; i < s->pat->nfa_len; ++i) {
+            if (s->sim.in[i] && cre_node_waits_(&s->pat->nfa[i])) b[i / 64] |= 1ULL << (i % 64);
+        }
+        if (s->sim.word) b[i / 64] |= 1ULL << (i % 64);
+    } else if (s->engine == cre_ENGINE_BSIM) {
+        memcpy(b, s->bsim.in, sizeof(*b) * s->bsim.nwords);
+    } else {
+        for (i = s->dfa.soff[s->s]; i < s->dfa.soff[s->s + 1]; ++i) {
+            b[s->dfa.snodes[i] / 64] |= 1ULL << (s->dfa.snodes[i] % 64);
+        }
+    }
+    if (s->approx) memcpy(b + nw, s->apx.R, sizeof(*s->apx.R) * (s->apx.k + 1));
+}
+
+void
+cre_srch_load(cre_srch* s, const void* state) {
+    const struct cre_srch_state_* st = state;
+    const uint64_t* b = (const uint64_t*)(st + 1);
+    int nw = (s->pat->nfa_len + 1 + 63) / 64, i;
+    s->nbytes = st->nbytes;
+    if (st->gen == s->gen && st->engine == cre_ENGINE_DFA && s->engine == cre_ENGINE_DFA) {
+        s->s = st->s;
+    } else if (s->engine == cre_ENGINE_DFA) {
+        // find the DFA state with the same nodes (which don't match anything when entered,
+        //   but that only matters for the byte before this point)
+        int n = 0;
+        for (i = 0; i <= s->pat->nfa_len; ++i) {
+            if ((b[i / 64] >> (i % 64)) & 1) s->dfa.list[n++] = i;
+        }
+        s->s = cre_dfa_add_(&s->dfa, n, 0);
+        if (s->s < 0) cre_srch_nodfa_(s, -1);
+    }
+    if (s->engine == cre_ENGINE_SIM) {
+        for (i = 0; i < s->pat->nfa_len; ++i) {
+            s->sim.in[i] = (b[i / 64] >> (i % 64)) & 1;
+        }
+        s->sim.word = (b[i / 64] >> (i % 64)) & 1;
+    } else if (s->engine == cre_ENGINE_BSIM) {
+        memset(s->bsim.in, 0, sizeof(*s->bsim.in) * s->bsim.nwords);
+        for (i = 0; i < s->pat->nfa_len; ++i) {
+            if ((b[i / 64] >> (i % 64)) & 1) s->bsim.in[i / 64] |= 1ULL << (i % 64);
+        }
+    }
+    if (s->approx) memcpy(s->apx.R, b + nw, sizeof(*s->apx.R) * (s->apx.k + 1));
+}
+
+int
+cre_srch_end(cre_srch* s) {
+    bool m = false;
+    if (s->approx || s->nbytes == 0) {
+        // approximate patterns have no word boundaries
+    } else if (s->engine == cre_ENGINE_DFA) {
+        m = s->dfa.words && s->dfa.eoi[s->s];
+    } else if (s->engine == cre_ENGINE_SIM) {
+        m = cre_sim_feedz(&s->sim, cre_END);
+    }
+    // NOTE: the bitset simulator is only used without word boundaries
+    return m ? cre_MATCH : cre_NOMATCH;
+}
+
+void
+cre_step_init(cre_step* st, cre_srch* s, const char* src, size_t len) {
+    cre_srch_reset(s);
+    st->srch = s;
+    st->src = src;
+    st->len = len;
+    st->pos = 0;
+    st->done = false;
+}
+
+int
+cre_search_step(cre_step* st, size_t max_bytes, int64_t max_ns, size_t* end) {
+    if (st->pos < st->len) {
+        cre_budget b;
+        memset(&b, 0, sizeof(b));
+        if (max_ns > 0) b.deadline = cre_now() + max_ns;
+        struct iovec iov = { (char*)st->src + st->pos, st->len - st->pos };
+        if (max_bytes > 0 && iov.iov_len > max_bytes) iov.iov_len = max_bytes;
+        size_t nbytes = st->srch->nbytes, e;
+        int res = cre_search_iov(st->srch, &iov, 1, 0, max_ns > 0 ? &b : NULL, &e);
+        // NOTE: every byte searched (or skipped) is counted, so this is how far it got, even
+        //         if it ran out of time partway through
+        st->pos += st->srch->nbytes - nbytes;
+        if (res == cre_MATCH) {
+            *end = st->pos;
+            return cre_MATCH;
+        }
+        if (res < 0) return res;
+        if (st->pos < st->len) return cre_BUDGET;
+    }
+    if (st->done) return cre_NOMATCH;
+    st->done = true;
+    if (cre_srch_end(st->srch) == cre_MATCH) {
+        *end = st->len;
+        return cre_MATCH;
+    }
+    return cre_NOMATCH;
+}
+
+
+//// IMPL: cre_lits ////
+
+// hash the 'B' bytes at 's'
+static uint32_t
+cre_lits_hash_(const cre_lits* l, const char* s) {
+    uint64_t x = 0;
+    int i;
+    for (i = 0; i < l->B; ++i) {
+        x = (x << 8) | (unsigned char)s[i];
+    }
+    return (uint32_t)((x * 0x9E3779B97F4A7C15ULL) >> (64 - l->tbits));
+}
+
+// pack the first (up to 4) bytes of a window
+static uint32_t
+cre_lits_fp_(const cre_lits* l, const char* s) {
+    uint32_t x = 0;
+    int i;
+    for (i = 0; i < l->m && i < 4; ++i) {
+        x |= (uint32_t)(unsigned char)s[i] << (8 * i);
+    }
+    return x;
+}
+
+char*
+cre_lits_init(cre_lits* l, const char** lits, const size_t* lens, int len) {
+    int i, j;
+    size_t nb = 0;
+    l->len = len;
+    l->m = 0;
+    for (i = 0; i < len; ++i) {
+        if (lens[i] == 0) {
+            char* err = malloc(64);
+            snprintf(err, 64, "literal %d is empty", i);
+            return err;
+        }
+        if (l->m == 0 || lens[i] < (size_t)l->m) l->m = lens[i] < 65535 ? lens[i] : 65535;
+        nb += lens[i];
+    }
+    if (len == 0) l->m = 1;
+
+    // blocks should be long enough that most of them aren't near the end of any literal's
+    //   window, which is about log(len * m) bytes (assuming ~16 distinct bytes, like hex)
+    size_t nb4 = 4 * (size_t)len * l->m;
+    l->B = 2;
+    while (l->B < 8 && ((size_t)1 << (4 * l->B)) < nb4) l->B++;
+    if (l->B > l->m) l->B = l->m;
+
+    // copy the literals
+    l->bytes = malloc(nb + 1);
+    l->off = malloc(sizeof(*l->off) * (len + 1));
+    for (i = 0, nb = 0; i < len; ++i) {
+        l->off[i] = nb;
+        memcpy(l->bytes + nb, lits[i], lens[i]);
+        nb += lens[i];
+    }
+    l->off[len] = nb;
+
+    // enough hash bits for each literal's blocks to be mostly alone
+    size_t nblocks = (size_t)len * (l->m - l->B + 1);
+    l->tbits = 12;
+    while (l->tbits < 22 && ((size_t)1 << l->tbits) < 4 * nblocks) l->tbits++;
+    size_t tsize = (size_t)1 << l->tbits;
+
+    // the shift for a block is how far it is from the end of the window, in any literal
+    l->shift = malloc(sizeof(*l->shift) * tsize);
+    for (i = 0; i < (int)tsize; ++i) {
+        l->shift[i] = l->m - l->B + 1;
+    }
+    l->head = calloc(tsize + 1, sizeof(*l->head));
+    for (i = 0; i < len; ++i) {
+        const char* s = l->bytes + l->off[i];
+        for (j = 0; j <= l->m - l->B; ++j) {
+            uint32_t h = cre_lits_hash_(l, s + j);
+            if (l->m - l->B - j < l->shift[h]) l->shift[h] = l->m - l->B - j;
+        }
+        l->head[cre_lits_hash_(l, s + l->m - l->B) + 1]++;
+    }
+
+    // bucket the literals by the hash of their window's last block (in order, so the first
+    //   one given is checked first)
+    for (i = 0; i < (int)tsize; ++i) {
+        l->head[i + 1] += l->head[i];
+    }
+    l->ids = malloc(sizeof(*l->ids) * (len + 1));
+    l->fp = malloc(sizeof(*l->fp) * (len + 1));
+    int* fill = malloc(sizeof(*fill) * tsize);
+    memcpy(fill, l->head, sizeof(*fill) * tsize);
+    for (i = 0; i < len; ++i) {
+        const char* s = l->bytes + l->off[i];
+        l->ids[fill[cre_lits_hash_(l, s + l->m - l->B)]++] = i;
+        l->fp[i] = cre_lits_fp_(l, s);
+    }
+    free(fill);
+    return NULL;
+}
+
+void
+cre_lits_free(cre_lits* l) {
+    free(l->bytes);
+    free(l->off);
+    free(l->shift);
+    free(l->head);
+    free(l->ids);
+    free(l->fp);
+}
+
+void
+cre_lits_memory_usage(cre_lits* l, cre_mem* res) {
+    size_t tsize = (size_t)1 << l->tbits;
+    memset(res, 0, sizeof(*res));
+    res->nfa = l->off[l->len] + 1 + sizeof(*l->off) * (l->len + 1);
+    res->prefilter = sizeof(*l->shift) * tsize + sizeof(*l->head) * (tsize + 1) + (sizeof(*l->ids) + sizeof(*l->fp)) * (l->len + 1);
+    cre_mem_total_(res);
+}
+
+int
+cre_lits_search(cre_lits* l, const char* src, size_t len, const cre_budget* budget, size_t* start, size_t* end, int* which) {
+    size_t n = len, p, it;
+    bool trunc = false;
+    int res, k;
+    if (budget && budget->max_bytes && n > budget->max_bytes) {
+        n = budget->max_bytes;
+        trunc = true;
+    }
+    if (l->len == 0) return trunc ? cre_BUDGET : cre_NOMATCH;
+
+    // 'p' is the end of the window
+    for (p = l->m, it = 0; p <= n; ++it) {
+        if (budget && it % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(budget, 0);
+            if (res != cre_NOMATCH) return res;
+        }
+        uint32_t h = cre_lits_hash_(l, src + p - l->B);
+        if (l->shift[h] > 0) {
+            p += l->shift[h];
+            continue;
+        }
+
+        // check the literals whose window ends with this block
+        size_t s = p - l->m;
+        uint32_t fp = cre_lits_fp_(l, src + s);
+        for (k = l->head[h]; k < l->head[h + 1]; ++k) {
+            int i = l->ids[k];
+            size_t ll = l->off[i + 1] - l->off[i];
+            if (l->fp[i] == fp && s + ll <= n && memcmp(src + s, l->bytes + l->off[i], ll) == 0) {
+                *start = s;
+                *end = s + ll;
+                *which = i;
+                return cre_MATCH;
+            }
+        }
+        p++;
+    }
+    return trunc ? cre_BUDGET : cre_NOMATCH;
+}
+
+
+//// IMPL: cre_rules ////
+
+char*
+cre_rules_init(cre_rules* r, const char** srcs, int len) {
+    int i;
+    cre_rules_ver* v = malloc(sizeof(*v));
+    char* err = cre_set_init(&v->set, srcs, len);
+    if (err) {
+        free(v);
+        return err;
+    }
+    v->version = 1;
+    v->retired = 0;
+    v->next = NULL;
+    r->cur = v;
+    r->epoch = 1;
+    for (i = 0; i < cre_RULES_MAX_READERS; ++i) {
+        r->slots[i] = 0;
+    }
+    for (i = 0; i < (cre_RULES_MAX_READERS + 63) / 64; ++i) {
+        r->used[i] = 0;
+    }
+    r->retired = NULL;
+    r->max_memory = 0;
+    pthread_mutex_init(&r->lock, NULL);
+    return NULL;
+}
+
+void
+cre_rules_free(cre_rules* r) {
+    cre_rules_ver* v = r->retired;
+    while (v) {
+        cre_rules_ver* next = v->next;
+        cre_set_free(&v->set);
+        free(v);
+        v = next;
+    }
+    cre_set_free(&r->cur->set);
+    free(r->cur);
+    pthread_mutex_destroy(&r->lock);
+}
+
+int
+cre_rules_reader(cre_rules* r) {
+    int i;
+    for (i = 0; i < (cre_RULES_MAX_READERS + 63) / 64; ++i) {
+        // claim the first free bit of this word, retrying if another thread claims (or
+        //   releases) one first
+        uint64_t w = __atomic_load_n(&r->used[i], __ATOMIC_RELAXED);
+        while (~w != 0) {
+            int b = __builtin_ctzll(~w);
+            if (i * 64 + b >= cre_RULES_MAX_READERS) break;
+            if (__atomic_compare_exchange_n(&r->used[i], &w, w | (1ULL << b), false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return i * 64 + b;
+            }
+        }
+    }
+    return -1;
+}
+
+void
+cre_rules_release(cre_rules* r, int slot) {
+    __atomic_store_n(&r->slots[slot], 0, __ATOMIC_RELEASE);
+    __atomic_fetch_and(&r->used[slot / 64], ~(1ULL << (slot % 64)), __ATOMIC_RELEASE);
+}
+
+cre_rules_ver*
+cre_rules_enter(cre_rules* r, int slot) {
+    // NOTE: the slot must be visible before the version is read, so that a swap after
+    //         this can't free the version we get (hence, sequentially consistent)
+    __atomic_store_n(&r->slots[slot], __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&r->cur, __ATOMIC_SEQ_CST);
+}
+
+void
+cre_rules_leave(cre_rules* r, int slot) {
+    __atomic_store_n(&r->slots[slot], 0, __ATOMIC_RELEASE);
+}
+
+char*
+cre_rules_swap(cre_rules* r, const char** srcs, int len) {
+    // compile it first, without holding anything up
+    cre_rules_ver* v = malloc(sizeof(*v));
+    char* err = cre_set_init(&v->set, srcs, len);
+    if (err) {
+        free(v);
+        return err;
+    }
+    if (r->max_memory > 0) {
+        // what a search of it takes (see 'cre_sim_memory_usage'), without building anything
+        cre_mem m;
+        cre_set_memory_usage(&v->set, &m);
+        size_t need = m.total + cre_sim_bytes_(&v->set.pat);
+        if (need > r->max_memory) {
+            cre_set_free(&v->set);
+            free(v);
+            err = malloc(96);
+            snprintf(err, 96, "rule set needs %zu bytes of memory, which is over the limit of %zu", need, r->max_memory);
+            return err;
+        }
+    }
+    v->retired = 0;
+    v->next = NULL;
+
+    pthread_mutex_lock(&r->lock);
+    cre_rules_ver* old = __atomic_load_n(&r->cur, __ATOMIC_RELAXED);
+    v->version = old->version + 1;
+    __atomic_store_n(&r->cur, v, __ATOMIC_SEQ_CST);
+
+    // searches that entered before the new epoch may still be using the old version
+    old->retired = __atomic_add_fetch(&r->epoch, 1, __ATOMIC_SEQ_CST);
+    old->next = r->retired;
+    r->retired = old;
+    pthread_mutex_unlock(&r->lock);
+
+    cre_rules_reclaim(r);
+    return NULL;
+}
+
+int
+cre_rules_reclaim(cre_rules* r) {
+    int i, left = 0;
+
+    pthread_mutex_lock(&r->lock);
+    // find the oldest epoch that a search is still in
+    // NOTE: slots that aren't being used are 0, so they are all checked
+    uint64_t oldest = UINT64_MAX;
+    for (i = 0; i < cre_RULES_MAX_READERS; ++i) {
+        uint64_t e = __atomic_load_n(&r->slots[i], __ATOMIC_SEQ_CST);
+        if (e != 0 && e < oldest) oldest = e;
+    }
+
+    // then, free versions that were replaced at or before it
+    cre_rules_ver** p = &r->retired;
+    while (*p) {
+        cre_rules_ver* v = *p;
+        if (v->retired <= oldest) {
+            *p = v->next;
+            cre_set_free(&v->set);
+            free(v);
+        } else {
+            p = &v->next;
+            left++;
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+    return left;
+}
+
+
+//// IMPL: cre_img ////
+
+// bytes at the start of a block, which change whenever its layout does
+#define cre_IMG_MAGIC "CREIMG02"
+
+// header at the start of a block, in which each '*_off' is where an array starts (from the
+//   start of the block)
+// NOTE: the DFA arrays are empty if 'nstates == 0'
+struct cre_img_hdr_ {
+    char magic[8];
+    uint64_t size;
+    int32_t nfa_len, nfa_start, ngroups, npats, nsets, src_len;
+    int32_t ncls, nstates, start, nnull, nsnodes, napats;
+    uint64_t nodes_off, sets_off, src_off, null_off, trans_off, soff_off, snodes_off, aoff_off, apats_off, eoi_off;
+    uint8_t cls[256];
+};
+
+// NFA node in a block, where 'set' is the index of its character set (or -1)
+struct cre_img_node_ {
+    int32_t kind, u, v, tag, set;
+};
+
+// round up to a multiple of 8, so that every array in a block is aligned
+static uint64_t
+cre_img_align_(uint64_t x) {
+    return (x + 7) & ~(uint64_t)7;
+}
+
+void*
+cre_img_build(cre_pat* pat, int max_states, size_t* size) {
+    return cre_img_build_profiled(pat, max_states, NULL, 0, size);
+}
+
+void*
+cre_img_build_profiled(cre_pat* pat, int max_states, const char* src, size_t len, size_t* size) {
+    int N = pat->nfa_len, i, c, s;
+    struct cre_img_hdr_ h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, cre_IMG_MAGIC, 8);
+
+    // build the whole DFA (after the states from the sample, so that its states are
+    //   numbered the way it enters them), and then put the states entered most first
+    cre_dfa d;
+    cre_dfa_init(&d, pat, false, max_states);
+    bool full = len == 0 || cre_dfa_profile(&d, src, len, NULL) == cre_NOMATCH;
+    full = full && cre_dfa_complete_(&d);
+    if (full) cre_dfa_relayout(&d);
+
+    h.nfa_len = N;
+    h.nfa_start = pat->nfa_start;
+    h.ngroups = pat->ngroups;
+    h.npats = pat->npats;
+    for (i = 0; i < N; ++i) {
+        if (pat->nfa[i].kind == cre_SET) h.nsets++;
+    }
+    h.src_len = strlen(pat->src);
+    if (full) {
+        h.ncls = d.ncls;
+        h.nstates = d.nstates;
+        h.start = d.start[0];
+        h.nnull = d.nnull;
+        h.nsnodes = d.soff[d.nstates];
+        h.napats = d.aoff[d.nstates];
+        memcpy(h.cls, d.cls, sizeof(h.cls));
+    }
+    int nsoff = full ? h.nstates + 1 : 0;
+
+    // lay out the arrays after the header
+    uint64_t off = cre_img_align_(sizeof(h));
+    h.nodes_off = off;
+    off = cre_img_align_(off + sizeof(struct cre_img_node_) * N);
+    h.sets_off = off;
+    off = cre_img_align_(off + 256 * (uint64_t)h.nsets);
+    h.src_off = off;
+    off = cre_img_align_(off + h.src_len + 1);
+    h.null_off = off;
+    off = cre_img_align_(off + sizeof(int32_t) * h.nnull);
+    h.trans_off = off;
+    off = cre_img_align_(off + sizeof(int32_t) * (uint64_t)h.nstates * h.ncls);
+    h.soff_off = off;
+    off = cre_img_align_(off + sizeof(int32_t) * nsoff);
+    h.snodes_off = off;
+    off = cre_img_align_(off + sizeof(int32_t) * h.nsnodes);
+    h.aoff_off = off;
+    off = cre_img_align_(off + sizeof(int32_t) * nsoff);
+    h.apats_off = off;
+    off = cre_img_align_(off + sizeof(int32_t) * h.napats);
+    h.eoi_off = off;
+    off = cre_img_align_(off + h.nstates);
+    h.size = off;
+
+    char* b = calloc(1, off);
+    memcpy(b, &h, sizeof(h));
+    struct cre_img_node_* nodes = (struct cre_img_node_*)(b + h.nodes_off);
+    uint8_t* sets = (uint8_t*)(b + h.sets_off);
+    int k = 0;
+    for (i = 0; i < N; ++i) {
+        const struct cre_node* n = &pat->nfa[i];
+        nodes[i].kind = n->kind;
+        nodes[i].u = n->u;
+        nodes[i].v = n->v;
+        nodes[i].tag = n->kind == cre_TAG ? n->tag : -1;
+        nodes[i].set = -1;
+        if (n->kind == cre_SET) {
+            for (c = 0; c < 256; ++c) {
+                sets[256 * k + c] = n->set[c];
+            }
+            nodes[i].set = k++;
+        }
+    }
+    memcpy(b + h.src_off, pat->src, h.src_len);
+    if (full) {
+        memcpy(b + h.null_off, d.null, sizeof(int32_t) * h.nnull);
+        memcpy(b + h.trans_off, d.trans, sizeof(int32_t) * h.nstates * h.ncls);
+        memcpy(b + h.soff_off, d.soff, sizeof(int32_t) * nsoff);
+        memcpy(b + h.snodes_off, d.snodes, sizeof(int32_t) * h.nsnodes);
+        memcpy(b + h.aoff_off, d.aoff, sizeof(int32_t) * nsoff);
+        memcpy(b + h.apats_off, d.apats, sizeof(int32_t) * h.napats);
+        for (s = 0; s < h.nstates; ++s) {
+            b[h.eoi_off + s] = d.words && d.eoi[s];
+        }
+    }
+    cre_dfa_free(&d);
+    *size = off;
+    return b;
+}
+
+// check that an array of 'n' elements of size 'sz' at offset 'off' is inside a block
+static bool
+cre_img_inside_(const struct cre_img_hdr_* h, uint64_t off, int64_t n, size_t sz) {
+    return n >= 0 && off % 8 == 0 && off <= h->size && (uint64_t)n * sz <= h->size - off;
+}
+
+// check that each of 'n' integers is in '[lo, hi)'
+static bool
+cre_img_range_(const int32_t* x, int64_t n, int lo, int hi) {
+    int64_t i;
+    for (i = 0; i < n; ++i) {
+        if (x[i] < lo || x[i] >= hi) return false;
+    }
+    return true;
+}
+
+// check that offsets go up from 0 to 'last'
+static bool
+cre_img_offs_(const int32_t* x, int n, int last) {
+    int i;
+    if (x[0] != 0 || x[n - 1] != last) return false;
+    for (i = 1; i < n; ++i) {
+        if (x[i] < x[i - 1]) return false;
+    }
+    return true;
+}
+
+char*
+cre_img_load(cre_img* img, const void* data, size_t size) {
+    const char* b = data;
+    const struct cre_img_hdr_* h = data;
+    int i, c;
+    // NOTE: the arrays are used in place, so they must be aligned
+    if ((uintptr_t)data % 8 != 0) return strdup("image is not aligned");
+    if (size < sizeof(*h) || memcmp(h->magic, cre_IMG_MAGIC, 8) != 0) return strdup("not an image (or from a different version)");
+    if (h->size != size) return strdup("image has the wrong size");
+
+    // check everything that is used for indexing, so a bad block can't go out of bounds
+    int N = h->nfa_len, P = h->npats, S = h->nstates;
+    bool ok = N > 0 && P >= 0 && P <= N && h->ngroups >= 0 && h->ngroups <= N && h->nsets >= 0 && h->src_len >= 0
+        && h->nfa_start >= 0 && h->nfa_start < N
+        && cre_img_inside_(h, h->nodes_off, N, sizeof(struct cre_img_node_))
+        && cre_img_inside_(h, h->sets_off, h->nsets, 256)
+        && cre_img_inside_(h, h->src_off, (int64_t)h->src_len + 1, 1)
+        && b[h->src_off + h->src_len] == '\0';
+    const struct cre_img_node_* nodes = ok ? (const struct cre_img_node_*)(b + h->nodes_off) : NULL;
+    const uint8_t* sets = ok ? (const uint8_t*)(b + h->sets_off) : NULL;
+    for (i = 0; ok && i < N; ++i) {
+        const struct cre_img_node_* n = &nodes[i];
+        ok = (n->kind == cre_EPS || n->kind == cre_SET || n->kind == cre_TAG || n->kind == cre_WORDB || n->kind == cre_NWORDB)
+            && n->u >= -1 - P && n->u < N && n->v >= -1 - P && n->v < N
+            && (n->kind == cre_SET ? n->set >= 0 && n->set < h->nsets : n->set == -1)
+            && (n->kind != cre_TAG || (n->tag >= 0 && n->tag < 2 * (h->ngroups + 1)));
+    }
+    for (i = 0; ok && i < 256 * h->nsets; ++i) {
+        ok = sets[i] <= 1;
+    }
+    if (ok && S > 0) {
+        ok = h->ncls > 0 && h->ncls <= 256 && h->start >= 0 && h->start < S
+            && h->nnull >= 0 && h->nsnodes >= 0 && h->napats >= 0
+            && cre_img_inside_(h, h->null_off, h->nnull, sizeof(int32_t))
+            && cre_img_inside_(h, h->trans_off, (int64_t)S * h->ncls, sizeof(int32_t))
+            && cre_img_inside_(h, h->soff_off, (int64_t)S + 1, sizeof(int32_t))
+            && cre_img_inside_(h, h->snodes_off, h->nsnodes, sizeof(int32_t))
+            && cre_img_inside_(h, h->aoff_off, (int64_t)S + 1, sizeof(int32_t))
+            && cre_img_inside_(h, h->apats_off, h->napats, sizeof(int32_t))
+            && cre_img_inside_(h, h->eoi_off, S, 1);
+        for (c = 0; ok && c < 256; ++c) {
+            ok = h->cls[c] < h->ncls;
+        }
+        for (i = 0; ok && i < S; ++i) {
+            ok = (uint8_t)b[h->eoi_off + i] <= 1;
+        }
+        ok = ok && cre_img_range_((const int32_t*)(b + h->null_off), h->nnull, 0, P)
+            && cre_img_range_((const int32_t*)(b + h->trans_off), (int64_t)S * h->ncls, 0, S)
+            && cre_img_offs_((const int32_t*)(b + h->soff_off), S + 1, h->nsnodes)
+            && cre_img_range_((const int32_t*)(b + h->snodes_off), h->nsnodes, 0, N + 1)
+            && cre_img_offs_((const int32_t*)(b + h->aoff_off), S + 1, h->napats)
+            && cre_img_range_((const int32_t*)(b + h->apats_off), h->napats, 0, 2 * P);
+    }
+    if (!ok) return strdup("image is corrupt");
+
+    // copy out the nodes, pointing their sets into the block
+    cre_pat* pat = &img->set.pat;
+    img->set.len = P;
+    pat->nfa_len = N;
+    pat->nfa = malloc(sizeof(*pat->nfa) * N);
+    pat->nfa_start = h->nfa_start;
+    pat->ngroups = h->ngroups;
+    pat->npats = P;
+    pat->src = (char*)(b + h->src_off);
+    for (i = 0; i < N; ++i) {
+        struct cre_node* n = &pat->nfa[i];
+        n->kind = nodes[i].kind;
+        n->u = nodes[i].u;
+        n->v = nodes[i].v;
+        n->tag = nodes[i].tag;
+        n->set = nodes[i].set >= 0 ? (bool*)(sets + 256 * nodes[i].set) : NULL;
+    }
+
+    // the DFA is complete, so only the tables that searching reads are needed
+    cre_dfa* d = &img->dfa;
+    memset(d, 0, sizeof(*d));
+    d->pat = pat;
+    if (S > 0) {
+        memcpy(d->cls, h->cls, sizeof(d->cls));
+        d->ncls = h->ncls;
+        d->nent = 1;
+        d->nnull = h->nnull;
+        d->null = (int*)(b + h->null_off);
+        d->nstates = d->states_cap = d->max_states = S;
+        d->soff = (int*)(b + h->soff_off);
+        d->snodes = (int*)(b + h->snodes_off);
+        d->aoff = (int*)(b + h->aoff_off);
+        d->apats = (int*)(b + h->apats_off);
+        d->trans = (int*)(b + h->trans_off);
+        d->start = (int*)&h->start;
+        d->words = cre_pat_words_(pat);
+        d->eoi = (bool*)(b + h->eoi_off);
+    }
+    img->data = data;
+    img->size = size;
+    img->mapped = false;
+    return NULL;
+}
+
+char*
+cre_img_map(cre_img* img, int fd) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) return strdup("could not stat image");
+    if (st.st_size <= 0) return strdup("image is empty");
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) return strdup("could not map image");
+    char* err = cre_img_load(img, data, st.st_size);
+    if (err) {
+        munmap(data, st.st_size);
+        return err;
+    }
+    img->mapped = true;
+    return NULL;
+}
+
+void
+cre_img_free(cre_img* img) {
+    free(img->set.pat.nfa);
+    if (img->mapped) munmap((void*)img->data, img->size);
+}
+
+
+//// IMPL: cre_shard ////
+
+// pattern and its weight (an estimate of how big it makes a DFA), for sorting
+struct cre_shard_w_ {
+    int pat;
+    int64_t w;
+};
+
+static int
+cre_shard_cmp_(const void* a, const void* b) {
+    const struct cre_shard_w_* x = a;
+    const struct cre_shard_w_* y = b;
+    // heaviest first, then in order
+    if (x->w != y->w) return x->w < y->w ? 1 : -1;
+    return x->pat - y->pat;
+}
+
+char*
+cre_shard_init(cre_shard* sh, const char** srcs, int len, int k) {
+    int i, j;
+    if (k > len) k = len;
+    if (k < 1) k = 1;
+    sh->len = len;
+    sh->nshards = k;
+
+    // weigh each pattern by the size of its own DFA, and more if matches can be
+    //   arbitrarily long, since those multiply the states of the others
+    struct cre_shard_w_* ws = malloc(sizeof(*ws) * (len + 1));
+    for (i = 0; i < len; ++i) {
+        cre_pat p;
+        cre_analysis a;
+        char* err = cre_pat_init(&p, srcs[i]);
+        if (err) {
+            int esz = strlen(err) + 32;
+            char* res = malloc(esz);
+            snprintf(res, esz, "pattern %d: %s", i, err);
+            free(err);
+            free(ws);
+            return res;
+        }
+        cre_pat_analyze(&p, &a);
+        ws[i].pat = i;
+        ws[i].w = a.dfa_explodes ? cre_ANALYZE_STATES : a.dfa_states;
+        if (a.max_len < 0) ws[i].w *= 4;
+        cre_pat_free(&p);
+    }
+
+    // then, give each pattern (heaviest first) to the lightest shard so far
+    qsort(ws, len, sizeof(*ws), cre_shard_cmp_);
+    int* which = malloc(sizeof(*which) * (len + 1));
+    int64_t* load = calloc(k, sizeof(*load));
+    for (i = 0; i < len; ++i) {
+        int best = 0;
+        for (j = 1; j < k; ++j) {
+            if (load[j] < load[best]) best = j;
+        }
+        which[ws[i].pat] = best;
+        load[best] += ws[i].w;
+    }
+    free(ws);
+    free(load);
+
+    // list the patterns of each shard, in order
+    sh->off = calloc(k + 1, sizeof(*sh->off));
+    sh->pats = malloc(sizeof(*sh->pats) * (len + 1));
+    for (i = 0; i < len; ++i) {
+        sh->off[which[i] + 1]++;
+    }
+    for (j = 0; j < k; ++j) {
+        sh->off[j + 1] += sh->off[j];
+    }
+    int* at = malloc(sizeof(*at) * k);
+    memcpy(at, sh->off, sizeof(*at) * k);
+    for (i = 0; i < len; ++i) {
+        sh->pats[at[which[i]]++] = i;
+    }
+    free(at);
+    free(which);
+
+    // compile each shard
+    const char** ss = malloc(sizeof(*ss) * (len + 1));
+    sh->shards = malloc(sizeof(*sh->shards) * k);
+    sh->dfas = malloc(sizeof(*sh->dfas) * k);
+    for (j = 0; j < k; ++j) {
+        int n = sh->off[j + 1] - sh->off[j];
+        for (i = 0; i < n; ++i) {
+            ss[i] = srcs[sh->pats[sh->off[j] + i]];
+        }
+        // NOTE: these already compiled above, so this can't fail
+        char* err = cre_set_init(&sh->shards[j], ss, n);
+        assert(err == NULL);
+        cre_dfa_init(&sh->dfas[j], &sh->shards[j].pat, false, 0);
+    }
+    free(ss);
+    return NULL;
+}
+
+void
+cre_shard_free(cre_shard* sh) {
+    int j;
+    for (j = 0; j < sh->nshards; ++j) {
+        cre_dfa_free(&sh->dfas[j]);
+        cre_set_free(&sh->shards[j]);
+    }
+    free(sh->dfas);
+    free(sh->shards);
+    free(sh->off);
+    free(sh->pats);
+}
+
+void
+cre_shard_memory_usage(cre_shard* sh, cre_mem* res) {
+    int j;
+    cre_mem m;
+    memset(res, 0, sizeof(*res));
+    res->nfa = (sizeof(*sh->shards) + sizeof(*sh->off)) * sh->nshards + sizeof(*sh->off) + sizeof(*sh->pats) * (sh->len + 1);
+    res->dfa = sizeof(*sh->dfas) * sh->nshards;
+    res->total = res->nfa + res->dfa;
+    for (j = 0; j < sh->nshards; ++j) {
+        cre_set_memory_usage(&sh->shards[j], &m);
+        cre_mem_add_(res, &m);
+        cre_dfa_memory_usage(&sh->dfas[j], &m);
+        cre_mem_add_(res, &m);
+    }
+}
+
+// throw away every state of a DFA except 's' (if it isn't -1), which becomes state 0
+// NOTE: this is what lets a shard keep going when its DFA gets too big, at the cost of
+//         rebuilding the states it needs again
+static int
+cre_shard_clear_(cre_dfa* d, int s) {
+    int i, n = s >= 0 ? d->soff[s + 1] - d->soff[s] : 0;
+    if (s >= 0) memcpy(d->list, &d->snodes[d->soff[s]], sizeof(int) * n);
+    d->nstates = 0;
+    for (i = 0; i < d->tab_cap; ++i) {
+        d->tab[i] = -1;
+    }
+    for (i = 0; i < d->nent; ++i) {
+        d->start[i] = -1;
+    }
+    return s >= 0 ? cre_dfa_add_(d, n, 0) : -1;
+}
+
+// search for one shard, run by its own thread
+struct cre_shard_job_ {
+    cre_dfa* d;
+    const char* src;
+    size_t len;
+    const cre_budget* budget;
+    // which of the shard's patterns matched
+    uint64_t* bits;
+    int res;
+};
+
+static void*
+cre_shard_run_(void* arg) {
+    struct cre_shard_job_* job = arg;
+    cre_dfa* d = job->d;
+    size_t n = job->len, i;
+    int j, res;
+    bool trunc = false;
+    if (job->budget && job->budget->max_bytes && n > job->budget->max_bytes) {
+        n = job->budget->max_bytes;
+        trunc = true;
+    }
+    job->res = cre_NOMATCH;
+    if (n > 0) {
+        // see 'cre_dfa_search' about patterns that match the empty string
+        for (j = 0; j < d->nnull; ++j) {
+            job->bits[d->null[j] / 64] |= 1ULL << (d->null[j] % 64);
+        }
+    }
+    int s = cre_dfa_entry(d, 0);
+    if (s < 0) {
+        // a previous search filled the DFA
+        cre_shard_clear_(d, -1);
+        s = cre_dfa_entry(d, 0);
+    }
+    for (i = 0; i < n; ++i) {
+        if (job->budget && i % cre_CHECK_EVERY == 0) {
+            res = cre_budget_check_(job->budget, 0);
+            if (res != cre_NOMATCH) {
+                job->res = res;
+                return NULL;
+            }
+        }
+        int t = d->trans[s * d->ncls + d->cls[(unsigned char)job->src[i]]];
+        if (t < 0 && (t = cre_dfa_next(d, s, job->src[i])) < 0) {
+            s = cre_shard_clear_(d, s);
+            t = cre_dfa_next(d, s, job->src[i]);
+        }
+        s = t;
+        for (j = d->aoff[s]; j < d->aoff[s + 1]; ++j) {
+            // NOTE: see 'cre_dfa.apats' about matches a word boundary decided late
+            int p = d->apats[j] < d->pat->npats ? d->apats[j] : d->apats[j] - d->pat->npats;
+            job->bits[p / 64] |= 1ULL << (p % 64);
+        }
+    }
+    if (trunc) {
+        job->res = cre_BUDGET;
+    } else if (d->words && n > 0) {
+        int np = cre_dfa_final_(d, s);
+        for (j = 0; j < np; ++j) {
+            job->bits[d->plist[j] / 64] |= 1ULL << (d->plist[j] % 64);
+        }
+    }
+    return NULL;
+}
+
+int
+cre_shard_search(cre_shard* sh, const char* src, size_t len, const cre_budget* budget, uint64_t* matched) {
+    int K = sh->nshards, nw = (sh->len + 63) / 64, i, j;
+    struct cre_shard_job_* jobs = malloc(sizeof(*jobs) * (K + 1));
+    pthread_t* threads = malloc(sizeof(*threads) * (K + 1));
+    for (j = 0; j < K; ++j) {
+        jobs[j].d = &sh->dfas[j];
+        jobs[j].src = src;
+        jobs[j].len = len;
+        jobs[j].budget = budget;
+        jobs[j].bits = calloc((sh->off[j + 1] - sh->off[j] + 63) / 64 + 1, sizeof(uint64_t));
+    }
+    // NOTE: the last shard is searched on this thread
+    for (j = 0; j < K - 1; ++j) {
+        if (pthread_create(&threads[j], NULL, cre_shard_run_, &jobs[j]) != 0) {
+            // no more threads, so search it here instead
+            cre_shard_run_(&jobs[j]);
+            threads[j] = pthread_self();
+        }
+    }
+    if (K > 0) cre_shard_run_(&jobs[K - 1]);
+
+    // merge each shard's matches, and stop early if any shard did
+    int res = cre_NOMATCH;
+    for (i = 0; i < nw; ++i) {
+        matched[i] = 0;
+    }
+    for (j = 0; j < K; ++j) {
+        if (j < K - 1 && !pthread_equal(threads[j], pthread_self())) pthread_join(threads[j], NULL);
+        for (i = sh->off[j]; i < sh->off[j + 1]; ++i) {
+            int li = i - sh->off[j], p = sh->pats[i];
+            if ((jobs[j].bits[li / 64] >> (li % 64)) & 1) {
+                matched[p / 64] |= 1ULL << (p % 64);
+                if (res == cre_NOMATCH) res = cre_MATCH;
+            }
+        }
+        if (jobs[j].res < 0 && (res >= 0 || jobs[j].res == cre_CANCEL)) res = jobs[j].res;
+        free(jobs[j].bits);
+    }
+    free(jobs);
+    free(threads);
+    return res;
+}
+
+
+//// IMPL: cre_iter ////
+
+void
+cre_iter_init(cre_iter* iter, cre_pat* pat) {
+    iter->pat = pat;
+
+    iter->paths_cap = iter->paths_len = 0;
+    iter->paths = NULL;
+
+    iter->buf_cap = iter->buf_len = 0;
+    iter->buf = NULL;
+
+    // start off by resetting it
+    cre_iter_reset(iter);
+}
+
+void
+cre_iter_free(cre_iter* iter) {
+    int i;
+    for (i = 0; i < iter->paths_cap; i++) {
+        struct cre_iter_path* p = &iter->paths[i];
+        // free each path's resources
+        cre_sim_free(&p->sim);
+        free(p->Gs);
+        free(p->Ge);
+    }
+    free(iter->paths);
+    free(iter->buf);
+}
+
+void
+cre_iter_reset(cre_iter* iter) {
+    // reset lengths to 0, but don't free
+    iter->paths_len = 0;
+    iter->buf_len = 0;
+}
+
+void
+cre_iter_memory_usage(cre_iter* iter, cre_mem* res) {
+    memset(res, 0, sizeof(*res));
+    // each path has a simulator, and a start and end for each group
+    res->scratch = iter->buf_cap + (size_t)iter->paths_cap * (sizeof(*iter->paths) + cre_sim_bytes_(iter->pat) + 2 * sizeof(int) * iter->pat->nfa_len);
+    cre_mem_total_(res);
+}
+
+// feed a single character to the iterator, returning whether there were any
+//   finalized matches produced
+bool
+cre_iter_feedc(cre_iter* iter, char c) {
+    int i, j;
+
+    // whether we have already added a new path
+    bool has_newpath = false;
+    for (i = 0; i < iter->paths_len; ++i) {
+        struct cre_iter_path* p = &iter->paths[i];
+        cre_sim* s = &p->sim;
+        if (!has_newpath && p->Ms < 0) {
+            // we don't have a new path yet, so add one
+            p->Ms = iter->buf_len;
+            p->Me = -1;
+            has_newpath = true;
+        } else if (!has_newpath && i == iter->paths_len - 1) {
+            // on last iteration and still don't have a new path, so append
+            // NOTE: this will cause there to be an extra iteration to handle it
+            if (iter->paths_len >= iter->paths_cap) {
+                // reallocate to append new state
+                iter->paths_cap = iter->paths_len * 2 + 4;
+                iter->paths = realloc(iter->paths, sizeof(*iter->paths) * iter->paths_cap);
+                for (j = iter->paths_len; j < iter->paths_cap; ++j) {
+                    struct cre_iter_path* p = &iter->paths[j];
+                    cre_sim_init(&p->sim, iter->pat);
+                    p->Gs = malloc(sizeof(*p->Gs) * iter->pat->nfa_len);
+                    p->Ge = malloc(sizeof(*p->Gs) * iter->pat->nfa_len);
+                }
+            }
+            // start a new path to match
+            iter->paths[iter->paths_len].Ms = iter->buf_len;
+            iter->paths[iter->paths_len].Me = -1;
+            iter->paths_len++;
+            has_newpath = true;
+        } 
+        if (p->Ms >= 0) {
+            // active path, so feed it
+            bool ismatch = cre_sim_feedc(s, c);
+            if (ismatch) {
+                // have a match, so update the end to the longest match
+                p->Me = iter->buf_len;
+            }   
+            // whether it has any state left (i.e. could still match)
+            bool has_instate = false;
+            for (j = 0; !has_instate && j < s->pat->nfa_len; ++j) {
+                has_instate = s->in[j];
+            }
+
+            if (!has_instate) {
+                // done with this path, so remove it and/or add match
                 if (p->Me >= 0) {
                     // we had a valid match, so add it to the queue
                 } else {
@@ -469,34 +6874,1902 @@ cre_iter_feedc(cre_iter* iter, char c) {
             }
         }
     }
+
+    // NOTE: finalized matches aren't queued yet
+    return false;
+}
+
+/// CLI ///
+
+// NOTE: compile with '-DEXE' to run as an executable
+#ifdef EXE
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+static void
+usage(char* argv0) {
+    fprintf(stderr, "usage: %s [options] pat files...\n", argv0);
+    fprintf(stderr, "       %s [options] -f lits files...\n", argv0);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "  --help       print this message\n");
+    fprintf(stderr, "  --explain    print what the pattern costs to search, and which engine is used\n");
+    fprintf(stderr, "  -k N         match approximately, with up to N errors (edit distance)\n");
+    fprintf(stderr, "  -f LITS      search for any of the literal strings in the file LITS (one per line)\n");
+    fprintf(stderr, "  --overlap    print the start and end offsets of every match, including overlapping ones\n");
+    fprintf(stderr, "  --follow     keep searching what is appended to the files (following rotation and truncation)\n");
+    fprintf(stderr, "  --cache F    keep results in cache file F, so unchanged files aren't read again (and appended\n");
+    fprintf(stderr, "               files are only read from where they were last searched)\n");
+    fprintf(stderr, "  -z           split files into records separated by NUL bytes, and print the records that match\n");
+    fprintf(stderr, "  --sep S      split files into records separated by S (which may have escapes like '\\n' and\n");
+    fprintf(stderr, "               '\\x00'), and print the records that match\n");
+    fprintf(stderr, "  --record P   split files into records of lines, each starting with a line that starts with\n");
+    fprintf(stderr, "               a match of P (e.g. a timestamp), and print the records that match\n");
+    fprintf(stderr, "  --field N    only search field N (from 1) of each record (or line, by default), and print\n");
+    fprintf(stderr, "               the records that match\n");
+    fprintf(stderr, "  --delim C    fields are separated by C (a tab, by default)\n");
+    fprintf(stderr, "  --daemon S   serve searches on the Unix socket S, keeping compiled patterns (and their DFAs)\n");
+    fprintf(stderr, "               between them\n");
+    fprintf(stderr, "  --connect S  search with the daemon on the Unix socket S (with -k, or neither)\n");
+    fprintf(stderr, "  --since T    only search the lines from the first one with a timestamp at or after T, by\n");
+    fprintf(stderr, "               binary searching files whose lines start with timestamps in order\n");
+    fprintf(stderr, "  --until T    only search the lines up to the last one with a timestamp at or before T (which\n");
+    fprintf(stderr, "               timestamps are cut to the length of, so '2024-01-02' is the whole day)\n");
+    fprintf(stderr, "  --ts P       timestamps are matches of P at the start of lines, which are compared as strings\n");
+    fprintf(stderr, "               (an ISO 8601 date and time, by default)\n");
+    fprintf(stderr, "  --count-by G print how many times each value of capture group G (0 for the whole match) was\n");
+    fprintf(stderr, "               matched, most common first (where matches don't span lines)\n");
+    fprintf(stderr, "  --top K      only print the K most common values for --count-by (10, by default, or 0 for all)\n");
+}
+
+// print an overlapping match (see 'cre_ovl_search')
+static bool
+print_ovl(void* ctx, int pat, size_t start, size_t end) {
+    (void)ctx;
+    (void)pat;
+    printf("%zu %zu\n", start, end);
+    return true;
+}
+
+// print a literal, escaping anything unprintable
+static void
+print_lit(const char* s, int len) {
+    int i;
+    putchar('"');
+    for (i = 0; i < len; ++i) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c >= ' ' && c < 127) {
+            putchar(c);
+        } else {
+            printf("\\x%02x", c);
+        }
+    }
+    putchar('"');
+}
+
+// print the report from 'cre_pat_analyze'
+static void
+explain(cre_pat* pat) {
+    cre_analysis a;
+    cre_pat_analyze(pat, &a);
+    int i;
+
+    printf("pattern:   %s\n", pat->src);
+    printf("nfa:       %d nodes (%zu bytes), %d groups\n", a.nfa_len, a.nfa_bytes, pat->ngroups);
+    printf("classes:   %d\n", a.nclasses);
+    if (a.dfa_explodes) {
+        printf("dfa:       more than %d states (explodes)\n", cre_ANALYZE_STATES);
+    } else {
+        printf("dfa:       %d states\n", a.dfa_states);
+        cre_pdfa p;
+        char* err = cre_pdfa_init(&p, pat, cre_ANALYZE_STATES, NULL, 0);
+        if (!err) {
+            cre_mem m;
+            cre_pdfa_memory_usage(&p, &m);
+            printf("packed:    %d-bit states (%zu bytes)\n", 8 * p.width, m.dfa);
+            cre_pdfa_free(&p);
+        }
+        free(err);
+    }
+    if (a.min_len < 0) {
+        printf("length:    never matches\n");
+    } else if (a.max_len < 0) {
+        printf("length:    %d..inf\n", a.min_len);
+    } else {
+        printf("length:    %d..%d\n", a.min_len, a.max_len);
+    }
+    printf("prefix:    ");
+    print_lit(a.prefix, a.prefix_len);
+    printf("\nfactors:  ");
+    for (i = 0; i < a.nfactors; ++i) {
+        putchar(' ');
+        print_lit(a.factors[i], a.factors_len[i]);
+    }
+    printf("\nonepass:   %s\n", a.onepass ? "yes" : "no");
+    printf("engine:    %s (%d steps/byte, %zu bytes)\n", cre_engine_name(a.engine), a.steps_per_byte, a.engine_bytes);
+}
+
+// magic bytes at the start of a result cache file (see '--cache')
+// NOTE: change the version when the saved searcher state changes
+#define CACHE_MAGIC "CRECACH2"
+
+// result cache record, for one file searched for one pattern, which is followed by the
+//   searcher's saved state (padded to 8 bytes) and the offset where each match ends
+// NOTE: these are stored one after another in the cache file (after 'CACHE_MAGIC'), and
+//         they are used right from where it is mapped into memory
+struct cache_rec {
+
+    // size of this record (including what follows it), in bytes
+    uint64_t len;
+
+    // the file's identity, and how much of it was searched (i.e. its size)
+    uint64_t dev, ino, size, mtime;
+
+    // hash of the pattern and options that it was searched with
+    uint64_t hash;
+
+    // number of matches, and the size of the searcher's state
+    uint64_t nmatches, state_size;
+
+    // whether another match ended at the end of the file (from a word boundary there)
+    // NOTE: this isn't in the offsets, since it doesn't hold once the file is appended to
+    uint64_t eoi;
+
+};
+
+// result cache, which holds records read from the cache file, and new ones
+struct cache {
+
+    // the cache file, and where it is mapped into memory (or NULL)
+    const char* path;
+    void* map;
+    size_t map_len;
+
+    // records, which are in 'map' or malloc'd (if they were added)
+    int len, cap;
+    struct cache_rec** recs;
+    bool* owned;
+
+};
+
+// return the searcher state of a cache record
+static void*
+cache_state(struct cache_rec* r) {
+    return r + 1;
+}
+
+// return the match offsets of a cache record
+static uint64_t*
+cache_offs(struct cache_rec* r) {
+    return (uint64_t*)((char*)(r + 1) + ((r->state_size + 7) & ~(uint64_t)7));
+}
+
+// read the records from a cache file (which may not exist yet)
+static void
+cache_load(struct cache* C, const char* path) {
+    C->path = path;
+    C->map = NULL;
+    C->map_len = 0;
+    C->len = C->cap = 0;
+    C->recs = NULL;
+    C->owned = NULL;
+
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return;
+    if (fstat(fd, &st) == 0 && st.st_size >= 8) {
+        C->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (C->map == MAP_FAILED) C->map = NULL;
+    }
+    close(fd);
+    if (!C->map) return;
+    C->map_len = st.st_size;
+    if (memcmp(C->map, CACHE_MAGIC, 8) != 0) return;
+
+    size_t off = 8;
+    while (off + sizeof(struct cache_rec) <= C->map_len) {
+        struct cache_rec* r = (struct cache_rec*)((char*)C->map + off);
+        if (r->len < sizeof(*r) || r->len % 8 != 0 || r->len > C->map_len - off) break;
+
+        // skip records whose state and offsets don't add up to their size (since the file
+        //   may have been corrupted, and they are trusted once they are loaded)
+        uint64_t room = r->len - sizeof(*r);
+        if (r->eoi > 1 || r->state_size > room || r->nmatches > room / 8
+            || sizeof(*r) + ((r->state_size + 7) & ~(uint64_t)7) + 8 * r->nmatches != r->len) {
+            off += r->len;
+            continue;
+        }
+        if (C->len >= C->cap) {
+            C->cap = 2 * C->cap + 16;
+            C->recs = realloc(C->recs, sizeof(*C->recs) * C->cap);
+            C->owned = realloc(C->owned, sizeof(*C->owned) * C->cap);
+        }
+        C->recs[C->len] = r;
+        C->owned[C->len++] = false;
+        off += r->len;
+    }
+}
+
+// return the record index for a file and pattern hash (or -1 if there isn't one)
+static int
+cache_find(struct cache* C, struct stat* st, uint64_t hash) {
+    int i;
+    for (i = 0; i < C->len; ++i) {
+        struct cache_rec* r = C->recs[i];
+        if (r->dev == (uint64_t)st->st_dev && r->ino == (uint64_t)st->st_ino && r->hash == hash) return i;
+    }
+    return -1;
+}
+
+// add (or replace, if 'i >= 0') a record, which should be malloc'd
+static void
+cache_put(struct cache* C, int i, struct cache_rec* r) {
+    if (i < 0) {
+        if (C->len >= C->cap) {
+            C->cap = 2 * C->cap + 16;
+            C->recs = realloc(C->recs, sizeof(*C->recs) * C->cap);
+            C->owned = realloc(C->owned, sizeof(*C->owned) * C->cap);
+        }
+        i = C->len++;
+    } else if (C->owned[i]) {
+        free(C->recs[i]);
+    }
+    C->recs[i] = r;
+    C->owned[i] = true;
+}
+
+// write the cache file (if anything changed), and free the cache
+static void
+cache_save(struct cache* C, char* argv0) {
+    int i;
+    bool changed = false;
+    for (i = 0; i < C->len; ++i) {
+        if (C->owned[i]) changed = true;
+    }
+    if (changed) {
+        // write to a temporary file, and then rename it, so readers never see half of it
+        size_t pl = strlen(C->path);
+        char* tmp = malloc(pl + 16);
+        snprintf(tmp, pl + 16, "%s.%d", C->path, (int)getpid());
+        FILE* fp = fopen(tmp, "wb");
+        if (fp) {
+            bool ok = fwrite(CACHE_MAGIC, 1, 8, fp) == 8;
+            for (i = 0; ok && i < C->len; ++i) {
+                ok = fwrite(C->recs[i], 1, C->recs[i]->len, fp) == C->recs[i]->len;
+            }
+            if (fclose(fp) != 0) ok = false;
+            if (!ok || rename(tmp, C->path) != 0) {
+                fprintf(stderr, "%s: %s: couldn't write cache\n", argv0, C->path);
+                remove(tmp);
+            }
+        } else {
+            perror(tmp);
+        }
+        free(tmp);
+    }
+    for (i = 0; i < C->len; ++i) {
+        if (C->owned[i]) free(C->recs[i]);
+    }
+    free(C->recs);
+    free(C->owned);
+    if (C->map) munmap(C->map, C->map_len);
+}
+
+// read all of a file into '*buf' (which is grown as needed), returning its length (or -1)
+static long
+read_all(const char* path, char** buf, size_t* bufsz) {
+    FILE* fp = fopen(path, "rb");
+    if (!fp) return -1;
+    size_t len = 0, sz;
+    while ((sz = fread(*buf + len, 1, *bufsz - len, fp)) > 0) {
+        len += sz;
+        if (len == *bufsz) {
+            *bufsz *= 2;
+            *buf = realloc(*buf, *bufsz);
+        }
+    }
+    fclose(fp);
+    return len;
+}
+
+// search files for any of the literals (one per line) in 'lits_path', with 'cre_lits'
+static int
+search_lits(char* argv0, const char* lits_path, int nfiles, char** paths) {
+    size_t bufsz = 4096;
+    char* lbuf = malloc(bufsz);
+    long llen = read_all(lits_path, &lbuf, &bufsz);
+    if (llen < 0) {
+        perror(lits_path);
+        return 1;
+    }
+
+    // split it into lines (skipping empty ones)
+    int n = 0, cap = 16, i;
+    const char** lits = malloc(sizeof(*lits) * cap);
+    size_t* lens = malloc(sizeof(*lens) * cap);
+    long p = 0;
+    while (p < llen) {
+        const char* nl = memchr(lbuf + p, '\n', llen - p);
+        long e = nl ? nl - lbuf : llen;
+        if (e > p) {
+            if (n >= cap) {
+                cap *= 2;
+                lits = realloc(lits, sizeof(*lits) * cap);
+                lens = realloc(lens, sizeof(*lens) * cap);
+            }
+            lits[n] = lbuf + p;
+            lens[n++] = e - p;
+        }
+        p = e + 1;
+    }
+
+    cre_lits l;
+    char* err = cre_lits_init(&l, lits, lens, n);
+    free(lits);
+    free(lens);
+    free(lbuf);
+    if (err) {
+        fprintf(stderr, "%s: %s: %s\n", argv0, lits_path, err);
+        free(err);
+        return 1;
+    }
+
+    // then, search each file (all at once, since literals may span buffers)
+    bufsz = 4096;
+    char* buf = malloc(bufsz);
+    for (i = 0; i < nfiles; ++i) {
+        long len = read_all(paths[i], &buf, &bufsz);
+        if (len < 0) {
+            perror(paths[i]);
+            exit(1);
+        }
+        size_t off = 0, start, end;
+        int which;
+        while (cre_lits_search(&l, buf + off, len - off, NULL, &start, &end, &which) == cre_MATCH) {
+            printf("MATCH\n");
+            off += end;
+        }
+    }
+    free(buf);
+    cre_lits_free(&l);
+    return 0;
+}
+
+// decode the escapes in 's' ('\\n', '\\t', '\\r', '\\0', '\\\\' and '\\xHH'), returning the bytes
+//   (which should be passed to 'free()') and setting '*len' to how many there are
+static char*
+unescape(const char* s, size_t* len) {
+    char* res = malloc(strlen(s) + 1);
+    size_t n = 0;
+    while (*s) {
+        if (*s != '\\' || !s[1]) {
+            res[n++] = *s++;
+            continue;
+        }
+        s++;
+        char c = *s++;
+        if (c == 'n') {
+            res[n++] = '\n';
+        } else if (c == 't') {
+            res[n++] = '\t';
+        } else if (c == 'r') {
+            res[n++] = '\r';
+        } else if (c == '0') {
+            res[n++] = '\0';
+        } else if (c == 'x' && isxdigit((unsigned char)s[0]) && isxdigit((unsigned char)s[1])) {
+            char hex[3] = { s[0], s[1], '\0' };
+            res[n++] = (char)strtol(hex, NULL, 16);
+            s += 2;
+        } else {
+            res[n++] = c;
+        }
+    }
+    *len = n;
+    return res;
+}
+
+// how files are split into records (see 'search_records')
+struct records {
+
+    // the separator between records (which may contain NUL bytes), or NULL if records
+    //   are lines, and one starts with each line that starts with a match of 'start'
+    const char* sep;
+    size_t sep_len;
+
+    // simulator for 'start', which is fed a line from the start (without starting other
+    //   match attempts), so it only matches at the start
+    cre_sim start;
+
+    // if 'field > 0', only that field (from 1) of each record is searched, where fields are
+    //   separated by 'delim'
+    int field;
+    char delim;
+
+};
+
+// return whether 'len' bytes of 'src' (a line) start with a match of the record start
+static bool
+record_starts(struct records* R, const char* src, size_t len) {
+    cre_sim* sim = &R->start;
+    size_t i;
+    int j;
+    cre_sim_reset(sim);
+    if (sim->null) return true;
+    for (i = 0; i < len; ++i) {
+        if (cre_sim_feedc(sim, src[i])) return true;
+        // stop as soon as nothing more can match
+        for (j = 0; j < sim->pat->nfa_len && !sim->in[j]; ++j) {}
+        if (j == sim->pat->nfa_len) return false;
+    }
+    return cre_sim_feedz(sim, cre_END);
+}
+
+// return where the record that starts at 'off' in 'len' bytes of 'src' ends, and set
+//   '*next' to where the next one starts
+// NOTE: records are found with 'memchr', which libc vectorizes, so only the first byte of
+//         a separator (or a newline) is looked for a byte at a time
+static size_t
+record_end(struct records* R, const char* src, size_t len, size_t off, size_t* next) {
+    size_t i = off;
+    while (i < len) {
+        const char* p = memchr(src + i, R->sep ? R->sep[0] : '\n', len - i);
+        if (!p) break;
+        i = p - src;
+        if (!R->sep) {
+            // a line ends here, so the record does if the next line starts another one
+            i++;
+            if (i < len && record_starts(R, src + i, len - i)) {
+                *next = i;
+                return i;
+            }
+        } else if (R->sep_len <= len - i && memcmp(src + i, R->sep, R->sep_len) == 0) {
+            *next = i + R->sep_len;
+            return i;
+        } else {
+            i++;
+        }
+    }
+    *next = len;
+    return len;
+}
+
+// search files record by record (so that matches never span records), printing the records
+//   that match (followed by the separator, or a newline if they don't end with one)
+static int
+search_records(char* argv0, cre_srch* srch, struct records* R, int nfiles, char** paths) {
+    size_t bufsz = 4096;
+    char* buf = malloc(bufsz);
+    int i;
+    for (i = 0; i < nfiles; ++i) {
+        long len = read_all(paths[i], &buf, &bufsz);
+        if (len < 0) {
+            fprintf(stderr, "%s: %s: %s\n", argv0, paths[i], strerror(errno));
+            free(buf);
+            return 1;
+        }
+        size_t off = 0, next, end;
+        while (off < (size_t)len) {
+            size_t rend = record_end(R, buf, len, off, &next);
+
+            // find the field, if only one is searched (skipping records that don't have it)
+            // NOTE: the rest of the record is never fed to the searcher
+            const char* fs = buf + off;
+            const char* fe = buf + rend;
+            int f;
+            for (f = 1; fs && f < R->field; ++f) {
+                fs = memchr(fs, R->delim, fe - fs);
+                if (fs) fs++;
+            }
+            if (!fs) {
+                off = next;
+                continue;
+            }
+            if (R->field > 0) {
+                const char* d = memchr(fs, R->delim, fe - fs);
+                if (d) fe = d;
+            }
+
+            // each record (or field) is searched as if it were a whole file
+            struct iovec iov = { (char*)fs, fe - fs };
+            cre_srch_reset(srch);
+            if (cre_search_iov(srch, &iov, 1, 0, NULL, &end) == cre_MATCH || cre_srch_end(srch) == cre_MATCH) {
+                fwrite(buf + off, 1, rend - off, stdout);
+                if (R->sep) {
+                    fwrite(R->sep, 1, R->sep_len, stdout);
+                } else if (rend == off || buf[rend - 1] != '\n') {
+                    putchar('\n');
+                }
+            }
+            off = next;
+        }
+    }
+    free(buf);
+    return 0;
+}
+
+// time window of files whose lines start with timestamps in order (see 'search_window')
+struct window {
+
+    // simulator for the timestamp pattern, which is fed a line from the start (like
+    //   'record_starts')
+    cre_sim ts;
+
+    // bounds of the window (either of which may be NULL), which timestamps are compared to
+    //   as strings, after cutting them to the length of the bound, so that e.g. an until of
+    //   '2024-01-02' includes all of that day
+    const char *since, *until;
+    size_t since_len, until_len;
+
+};
+
+// return the length of the longest match of the timestamp pattern that 'len' bytes of 'src'
+//   (a line, up to a newline) start with, or -1 if it doesn't start with one
+static long
+window_ts(struct window* W, const char* src, size_t len) {
+    cre_sim* sim = &W->ts;
+    long res = -1;
+    size_t i;
+    int j;
+    cre_sim_reset(sim);
+    if (sim->null) res = 0;
+    for (i = 0; i < len && src[i] != '\n'; ++i) {
+        if (cre_sim_feedc(sim, src[i])) res = i + 1;
+        // stop as soon as nothing more can match
+        for (j = 0; j < sim->pat->nfa_len && !sim->in[j]; ++j) {}
+        if (j == sim->pat->nfa_len) return res;
+    }
+    return cre_sim_feedz(sim, cre_END) ? (long)i : res;
+}
+
+// compare a timestamp with a bound of the window (see 'struct window')
+static int
+window_cmp(const char* ts, size_t ts_len, const char* b, size_t b_len) {
+    int c = memcmp(ts, b, ts_len < b_len ? ts_len : b_len);
+    if (c != 0) return c;
+    return ts_len < b_len ? -1 : 0;
+}
+
+// return where the line after the one containing offset 'off' of 'len' bytes of 'src' starts
+//   (or 'off', if it is a line start)
+static size_t
+window_line(const char* src, size_t len, size_t off) {
+    if (off == 0 || off >= len) return off < len ? off : len;
+    const char* nl = memchr(src + off - 1, '\n', len - off + 1);
+    return nl ? (size_t)(nl - src) + 1 : len;
+}
+
+// return where the first line of 'len' bytes of 'src' with a timestamp past a bound of the
+//   window (after 'b', or at or after it if 'incl') starts, or 'len' if none is, by binary
+//   searching (so only a few lines are ever read, which is what makes huge files cheap)
+// NOTE: lines without a timestamp (e.g. the rest of a multi-line message) are skipped over,
+//         so they go with the line before them
+static size_t
+window_find(struct window* W, const char* src, size_t len, const char* b, size_t b_len, bool incl) {
+    size_t lo = 0, hi = len;
+    // NOTE: timestamped lines that start before 'lo' aren't past the bound, and the first one
+    //         that starts at or after (the line at) 'hi' is (if there is one)
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2, q = window_line(src, len, mid), next = len;
+        long n = -1;
+        for (; q < len; q = next) {
+            next = window_line(src, len, q + 1);
+            if ((n = window_ts(W, src + q, len - q)) >= 0) break;
+        }
+        int c = q < len ? window_cmp(src + q, n, b, b_len) : 1;
+        if (c > 0 || (incl && c == 0)) {
+            hi = mid;
+        } else {
+            lo = next;
+        }
+    }
+    while (lo < len && window_ts(W, src + lo, len - lo) < 0) {
+        lo = window_line(src, len, lo + 1);
+    }
+    return lo;
+}
+
+// search only the lines of files in a time window, which are found by binary searching each
+//   file (mapped into memory) for the window's bounds, so that only the bytes in it are
+//   searched
+static int
+search_window(char* argv0, cre_srch* srch, struct window* W, int nfiles, char** paths) {
+    int i;
+    for (i = 0; i < nfiles; ++i) {
+        int fd = open(paths[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            fprintf(stderr, "%s: %s: %s\n", argv0, paths[i], strerror(errno));
+            return 1;
+        }
+        size_t len = st.st_size, start = 0, stop = len, end = 0;
+        if (len == 0) {
+            close(fd);
+            continue;
+        }
+        char* data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            fprintf(stderr, "%s: %s: %s\n", argv0, paths[i], strerror(errno));
+            return 1;
+        }
+
+        // only a few pages are read while probing, so don't read ahead of them
+        madvise(data, len, MADV_RANDOM);
+        if (W->since) start = window_find(W, data, len, W->since, W->since_len, true);
+        if (W->until) stop = window_find(W, data + start, len - start, W->until, W->until_len, false) + start;
+
+        // then, search the window as if it were the whole file
+        long pg = sysconf(_SC_PAGESIZE);
+        size_t a = start - start % pg;
+        madvise(data + a, stop - a, MADV_SEQUENTIAL);
+        struct iovec iov = { data + start, stop - start };
+        cre_srch_reset(srch);
+        while (cre_search_iov(srch, &iov, 1, end, NULL, &end) == cre_MATCH) {
+            printf("MATCH\n");
+        }
+        if (cre_srch_end(srch) == cre_MATCH) printf("MATCH\n");
+        munmap(data, len);
+    }
+    return 0;
+}
+
+// most bytes of a file that a thread counts at a time (see 'count_by')
+#define COUNT_CHUNK (1 << 24)
+
+// block of the arena that keys are kept in
+struct count_block {
+    struct count_block* next;
+    size_t len, cap;
+    char data[];
+};
+
+// counted key, which is empty if 'key' is NULL
+struct count_ent {
+    const char* key;
+    size_t len;
+    uint64_t hash, n;
+};
+
+// hash table of how many times each key was found (see 'count_by'), with open addressing
+//   and linear probing
+// NOTE: keys are copied into an arena, so that each one isn't its own allocation
+struct counts {
+    struct count_ent* ents;
+    size_t cap, len;
+    struct count_block* arena;
+};
+
+// piece of a file for a thread to count, which is whole lines
+struct count_chunk {
+    const char* src;
+    size_t len;
+};
+
+// state of a thread counting with 'count_by', which has its own searchers and table (so
+//   there is nothing to lock), and takes chunks until there are none left
+struct count_thread {
+
+    // the pattern and group being counted, and all of the chunks
+    cre_pat* pat;
+    int group;
+    struct count_chunk* chunks;
+    int nchunks;
+
+    // index of the next chunk to take, which is shared by all of the threads (and only
+    //   accessed with '__atomic' builtins)
+    int* next;
+
+    // what this thread has counted
+    struct counts C;
+    pthread_t th;
+
+};
+
+// hash a key (with FNV-1a, like the cache)
+static uint64_t
+count_hash(const char* key, size_t len) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    size_t i;
+    for (i = 0; i < len; ++i) {
+        h = (h ^ (unsigned char)key[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// add 'n' to the count of a key, copying it into the arena if it is new (and 'copy',
+//   otherwise it must outlive the table)
+static void
+count_add(struct counts* C, const char* key, size_t len, uint64_t h, uint64_t n, bool copy) {
+    size_t i, j;
+    if (2 * (C->len + 1) > C->cap) {
+        // grow it, so it stays at most half full
+        size_t cap = C->cap ? 2 * C->cap : 1024;
+        struct count_ent* ents = calloc(cap, sizeof(*ents));
+        for (i = 0; i < C->cap; ++i) {
+            if (!C->ents[i].key) continue;
+            for (j = C->ents[i].hash & (cap - 1); ents[j].key; j = (j + 1) & (cap - 1)) {}
+            ents[j] = C->ents[i];
+        }
+        free(C->ents);
+        C->ents = ents;
+        C->cap = cap;
+    }
+    for (i = h & (C->cap - 1); C->ents[i].key; i = (i + 1) & (C->cap - 1)) {
+        struct count_ent* e = &C->ents[i];
+        if (e->hash == h && e->len == len && memcmp(e->key, key, len) == 0) {
+            e->n += n;
+            return;
+        }
+    }
+    if (copy) {
+        struct count_block* b = C->arena;
+        if (!b || b->cap - b->len < len + 1) {
+            size_t cap = len + 1 > 65536 ? len + 1 : 65536;
+            b = malloc(sizeof(*b) + cap);
+            b->next = C->arena;
+            b->len = 0;
+            b->cap = cap;
+            C->arena = b;
+        }
+        // NOTE: every key has a byte after it, so that empty keys aren't NULL
+        memcpy(b->data + b->len, key, len);
+        key = b->data + b->len;
+        b->len += len + 1;
+    }
+    C->ents[i].key = key;
+    C->ents[i].len = len;
+    C->ents[i].hash = h;
+    C->ents[i].n = n;
+    C->len++;
+}
+
+// free a table of counts
+static void
+count_free(struct counts* C) {
+    while (C->arena) {
+        struct count_block* b = C->arena;
+        C->arena = b->next;
+        free(b);
+    }
+    free(C->ents);
+}
+
+// compare counted keys, so that more common ones come first (and then in order of their
+//   bytes, so the output doesn't depend on the order they were found in)
+static int
+count_cmp(const void* a, const void* b) {
+    const struct count_ent* x = a;
+    const struct count_ent* y = b;
+    if (x->n != y->n) return x->n > y->n ? -1 : 1;
+    int c = memcmp(x->key, y->key, x->len < y->len ? x->len : y->len);
+    if (c != 0) return c;
+    return x->len < y->len ? -1 : x->len > y->len;
+}
+
+// move the entry at 'i' of a heap of 'n' down, so the last (by 'count_cmp') is on top
+static void
+count_sift(struct count_ent* H, size_t n, size_t i) {
+    while (true) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < n && count_cmp(&H[l], &H[m]) > 0) m = l;
+        if (r < n && count_cmp(&H[r], &H[m]) > 0) m = r;
+        if (m == i) break;
+        struct count_ent t = H[i];
+        H[i] = H[m];
+        H[m] = t;
+        i = m;
+    }
+}
+
+// count the matches in the chunks, taking them until there are none left
+// NOTE: each line is searched with the streaming searcher first, and only lines where it
+//         finds a match are searched for the group with the tagged DFA
+static void*
+count_run(void* arg) {
+    struct count_thread* T = arg;
+    int G = T->group, k;
+    cre_srch srch;
+    cre_tdfa d;
+    int64_t* groups = malloc(sizeof(*groups) * 2 * (T->pat->ngroups + 1));
+    cre_srch_init(&srch, T->pat, -1);
+    cre_tdfa_init(&d, T->pat, NULL);
+    while ((k = __atomic_fetch_add(T->next, 1, __ATOMIC_RELAXED)) < T->nchunks) {
+        const char* src = T->chunks[k].src;
+        size_t len = T->chunks[k].len, off = 0, end;
+        while (off < len) {
+            struct iovec iov = { (char*)src + off, len - off };
+            cre_srch_reset(&srch);
+            if (cre_search_iov(&srch, &iov, 1, 0, NULL, &end) != cre_MATCH) break;
+
+            // no line before the one where it ended has a match (since matches within a line
+            //   are also matches of the whole chunk), so count the ones in that line
+            // NOTE: patterns have no anchors, and the tagged DFA has no word boundaries
+            size_t ls = off + end - 1, le;
+            while (ls > off && src[ls - 1] != '\n') ls--;
+            const char* nl = memchr(src + off + end - 1, '\n', len - (off + end - 1));
+            le = nl ? (size_t)(nl - src) : len;
+            size_t p = ls;
+            while (p <= le && cre_tdfa_search(&d, src + p, le - p, NULL, groups) == cre_MATCH) {
+                if (groups[2 * G] >= 0) {
+                    const char* key = src + p + groups[2 * G];
+                    size_t klen = groups[2 * G + 1] - groups[2 * G];
+                    count_add(&T->C, key, klen, count_hash(key, klen), 1, true);
+                }
+                // NOTE: an empty match is skipped over, so the next one can't be the same
+                p += groups[1] > groups[0] ? groups[1] : groups[1] + 1;
+            }
+            off = le + 1;
+        }
+    }
+    cre_tdfa_free(&d);
+    cre_srch_free(&srch);
+    free(groups);
+    return NULL;
+}
+
+// count the values of capture group 'group' in every match (which doesn't span lines) in
+//   files, and print the 'top' most common ones (or all of them, if it is 0) with their
+//   counts, like 'sort | uniq -c | sort -rn | head' would
+// NOTE: files are mapped into memory and split into chunks of lines, which are counted by
+//         a thread for each CPU into its own table, and the tables are merged at the end
+static int
+count_by(char* argv0, cre_pat* pat, int group, size_t top, int nfiles, char** paths) {
+    cre_tdfa d;
+    if (cre_tdfa_init(&d, pat, NULL) != 0) {
+        fprintf(stderr, "%s: --count-by needs a tagged DFA, but the pattern is too big for one (or has word boundaries)\n", argv0);
+        return 1;
+    }
+    cre_tdfa_free(&d);
+
+    // map the files, and split them into chunks (at the end of a line)
+    char** maps = calloc(nfiles, sizeof(*maps));
+    size_t* lens = calloc(nfiles, sizeof(*lens));
+    struct count_chunk* chunks = NULL;
+    int nchunks = 0, cap = 0, i, j;
+    for (i = 0; i < nfiles; ++i) {
+        int fd = open(paths[i], O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            perror(paths[i]);
+            exit(1);
+        }
+        lens[i] = st.st_size;
+        if (lens[i] > 0) {
+            maps[i] = mmap(NULL, lens[i], PROT_READ, MAP_PRIVATE, fd, 0);
+            if (maps[i] == MAP_FAILED) {
+                perror(paths[i]);
+                exit(1);
+            }
+            madvise(maps[i], lens[i], MADV_SEQUENTIAL);
+        }
+        close(fd);
+        size_t off = 0;
+        while (off < lens[i]) {
+            size_t e = lens[i];
+            if (e - off > COUNT_CHUNK) {
+                const char* nl = memchr(maps[i] + off + COUNT_CHUNK, '\n', e - off - COUNT_CHUNK);
+                if (nl) e = nl - maps[i] + 1;
+            }
+            if (nchunks >= cap) {
+                cap = 2 * cap + 16;
+                chunks = realloc(chunks, sizeof(*chunks) * cap);
+            }
+            chunks[nchunks].src = maps[i] + off;
+            chunks[nchunks++].len = e - off;
+            off = e;
+        }
+    }
+
+    // count them, with a thread for each CPU (but not more than there are chunks)
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN), next = 0;
+    if (nthreads > nchunks) nthreads = nchunks;
+    if (nthreads < 1) nthreads = 1;
+    struct count_thread* T = calloc(nthreads, sizeof(*T));
+    for (i = 0; i < nthreads; ++i) {
+        T[i].pat = pat;
+        T[i].group = group;
+        T[i].chunks = chunks;
+        T[i].nchunks = nchunks;
+        T[i].next = &next;
+        if (i > 0 && pthread_create(&T[i].th, NULL, count_run, &T[i]) != 0) {
+            fprintf(stderr, "%s: failed to create a thread\n", argv0);
+            exit(1);
+        }
+    }
+    count_run(&T[0]);
+    for (i = 1; i < nthreads; ++i) {
+        pthread_join(T[i].th, NULL);
+    }
+
+    // merge the tables into the first one (whose keys can stay in their arenas, which are
+    //   only freed at the end)
+    struct counts* C = &T[0].C;
+    for (i = 1; i < nthreads; ++i) {
+        size_t k;
+        for (k = 0; k < T[i].C.cap; ++k) {
+            struct count_ent* e = &T[i].C.ents[k];
+            if (e->key) count_add(C, e->key, e->len, e->hash, e->n, false);
+        }
+    }
+
+    // then, find the most common ones (keeping the top ones in a heap, so only they are
+    //   sorted)
+    size_t n = 0, k;
+    if (top == 0 || top > C->len) top = C->len;
+    struct count_ent* H = malloc(sizeof(*H) * (top + 1));
+    for (k = 0; k < C->cap && top > 0; ++k) {
+        if (!C->ents[k].key) continue;
+        if (n < top) {
+            H[n++] = C->ents[k];
+            if (n == top) {
+                for (j = top / 2; j >= 0; --j) {
+                    count_sift(H, n, j);
+                }
+            }
+        } else if (count_cmp(&C->ents[k], &H[0]) < 0) {
+            H[0] = C->ents[k];
+            count_sift(H, n, 0);
+        }
+    }
+    qsort(H, n, sizeof(*H), count_cmp);
+    for (k = 0; k < n; ++k) {
+        printf("%7llu ", (unsigned long long)H[k].n);
+        fwrite(H[k].key, 1, H[k].len, stdout);
+        putchar('\n');
+    }
+
+    free(H);
+    for (i = 0; i < nthreads; ++i) {
+        count_free(&T[i].C);
+    }
+    free(T);
+    free(chunks);
+    for (i = 0; i < nfiles; ++i) {
+        if (maps[i]) munmap(maps[i], lens[i]);
+    }
+    free(maps);
+    free(lens);
+    return 0;
 }
 
-/// CLI ///
+// magic number at the start of each request to, and response from, the daemon (see
+//   '--daemon'), which changes whenever the protocol does
+#define DAEMON_MAGIC 0x31455243
 
-// NOTE: compile with '-DEXE' to run as an executable
-#ifdef EXE
+// most patterns that the daemon keeps compiled
+#define DAEMON_MAX_PATS 64
+
+// most errors that a request may allow (approximate patterns are at most 64 long, so more
+//   would never change the results)
+#define DAEMON_MAX_K 64
+
+// request to the daemon, which is followed by the pattern, and then each path (as a
+//   'uint32_t' length, and then its bytes)
+// NOTE: everything is in the host's byte order, since the socket is local
+struct daemon_req {
+    uint32_t magic;
+    int32_t k;
+    uint32_t pat_len, npaths;
+};
+
+// response from the daemon, which is followed by an error message (if 'err_len > 0', in
+//   which case that is all), or a 'struct daemon_file' for each path (in order)
+struct daemon_res {
+    uint32_t magic;
+    uint32_t err_len;
+};
+
+// results for one file, which is followed by the offset where each match ends
+struct daemon_file {
+    // 0, or the 'errno' from opening or reading the file
+    int32_t err;
+    uint32_t pad;
+    uint64_t nmatches;
+};
+
+// compiled pattern kept by the daemon
+struct daemon_pat {
+
+    // the source and '-k' it was compiled with, and the pattern
+    char* src;
+    int k;
+    cre_pat pat;
+
+    // searchers that aren't being used, each of which keeps its DFA between searches
+    int nidle, idle_cap;
+    cre_srch** idle;
+
+    // number of searchers being used, and when it was last used (for evicting it)
+    int users;
+    uint64_t last;
+
+    // whether it is kept in the daemon's patterns (if not, because all of them were being
+    //   used, it is freed once its searcher is given back)
+    bool kept;
+
+};
+
+// state of the daemon, which is shared by its threads
+struct daemon {
+
+    // lock for everything else, and a condition for when a connection is queued
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    // queue of connections waiting for a thread
+    int* queue;
+    int qhead, qlen, qcap;
+
+    // compiled patterns, and a counter for when they were used
+    int npats;
+    struct daemon_pat* pats[DAEMON_MAX_PATS];
+    uint64_t tick;
+
+};
+
+// read exactly 'len' bytes from a socket, returning whether it could
+static bool
+sock_read(int fd, void* buf, size_t len) {
+    char* p = buf;
+    while (len > 0) {
+        ssize_t sz = read(fd, p, len);
+        if (sz < 0 && errno == EINTR) continue;
+        if (sz <= 0) return false;
+        p += sz;
+        len -= sz;
+    }
+    return true;
+}
+
+// write exactly 'len' bytes to a socket, returning whether it could
+static bool
+sock_write(int fd, const void* buf, size_t len) {
+    const char* p = buf;
+    while (len > 0) {
+        ssize_t sz = send(fd, p, len, MSG_NOSIGNAL);
+        if (sz < 0 && errno == EINTR) continue;
+        if (sz <= 0) return false;
+        p += sz;
+        len -= sz;
+    }
+    return true;
+}
+
+// find a pattern that the daemon keeps (with the lock held), or NULL
+static struct daemon_pat*
+daemon_find(struct daemon* D, const char* src, int k) {
+    int i;
+    for (i = 0; i < D->npats; ++i) {
+        if (D->pats[i]->k == k && strcmp(D->pats[i]->src, src) == 0) return D->pats[i];
+    }
+    return NULL;
+}
+
+// free a pattern that the daemon kept, and its searchers
+static void
+daemon_pat_free(struct daemon_pat* P) {
+    int i;
+    for (i = 0; i < P->nidle; ++i) {
+        cre_srch_free(P->idle[i]);
+        free(P->idle[i]);
+    }
+    free(P->idle);
+    cre_pat_free(&P->pat);
+    free(P->src);
+    free(P);
+}
+
+// get a searcher for a pattern, compiling it if it isn't kept already, and returning NULL
+//   (and setting '*err', which should be passed to 'free()') if it doesn't compile
+// NOTE: patterns are compiled without the lock, so that an expensive one doesn't hold up
+//         the other connections
+static cre_srch*
+daemon_get(struct daemon* D, const char* src, int k, struct daemon_pat** dp, char** err) {
+    int i;
+    struct daemon_pat *P, *N = NULL, *O = NULL;
+    pthread_mutex_lock(&D->lock);
+    P = daemon_find(D, src, k);
+    if (!P) {
+        pthread_mutex_unlock(&D->lock);
+        N = calloc(1, sizeof(*N));
+        *err = cre_pat_init(&N->pat, src);
+        if (*err) {
+            free(N);
+            return NULL;
+        }
+        N->src = strdup(src);
+        N->k = k;
+
+        // another connection may have compiled it in the meantime, in which case that one
+        //   is used (and this one is freed)
+        pthread_mutex_lock(&D->lock);
+        P = daemon_find(D, src, k);
+    }
+    if (!P) {
+        P = N;
+        N = NULL;
+
+        // make room by evicting the pattern used longest ago (that isn't being used), and if
+        //   every one is being used, search with this one without keeping it
+        if (D->npats >= DAEMON_MAX_PATS) {
+            int old = -1;
+            for (i = 0; i < D->npats; ++i) {
+                if (D->pats[i]->users == 0 && (old < 0 || D->pats[i]->last < D->pats[old]->last)) old = i;
+            }
+            if (old >= 0) {
+                O = D->pats[old];
+                D->pats[old] = D->pats[--D->npats];
+            }
+        }
+        if (D->npats < DAEMON_MAX_PATS) {
+            P->kept = true;
+            D->pats[D->npats++] = P;
+        }
+    }
+    P->users++;
+    P->last = ++D->tick;
+    cre_srch* s = P->nidle > 0 ? P->idle[--P->nidle] : NULL;
+    pthread_mutex_unlock(&D->lock);
+    if (N) daemon_pat_free(N);
+    if (O) daemon_pat_free(O);
+
+    if (!s) {
+        // every searcher is being used, so make another one
+        s = malloc(sizeof(*s));
+        *err = cre_srch_init(s, &P->pat, k);
+        if (*err) {
+            free(s);
+            if (!P->kept) {
+                daemon_pat_free(P);
+                return NULL;
+            }
+            pthread_mutex_lock(&D->lock);
+            P->users--;
+            pthread_mutex_unlock(&D->lock);
+            return NULL;
+        }
+    }
+    *dp = P;
+    return s;
+}
+
+// give back a searcher from 'daemon_get'
+static void
+daemon_put(struct daemon* D, struct daemon_pat* P, cre_srch* s) {
+    if (!P->kept) {
+        // NOTE: nothing else can see it, so it doesn't need the lock
+        cre_srch_free(s);
+        free(s);
+        daemon_pat_free(P);
+        return;
+    }
+    pthread_mutex_lock(&D->lock);
+    if (P->nidle >= P->idle_cap) {
+        P->idle_cap = 2 * P->idle_cap + 4;
+        P->idle = realloc(P->idle, sizeof(*P->idle) * P->idle_cap);
+    }
+    P->idle[P->nidle++] = s;
+    P->users--;
+    pthread_mutex_unlock(&D->lock);
+}
+
+// search a file for the daemon, adding where each match ends to '*offs', and returning 0
+//   or an 'errno'
+// NOTE: the file is mapped rather than read, so that it is searched right from the page
+//         cache, and the kernel is told that it is read in order
+static int
+daemon_search(cre_srch* s, const char* path, uint64_t** offs, size_t* noffs, size_t* cap) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return errno;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int e = errno;
+        close(fd);
+        return e;
+    }
+    size_t len = st.st_size, end = 0;
+    void* data = NULL;
+    if (len > 0) {
+        data = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            int e = errno;
+            close(fd);
+            return e;
+        }
+        madvise(data, len, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    cre_srch_reset(s);
+    struct iovec iov = { data, len };
+    bool last = false;
+    while (!last) {
+        if (cre_search_iov(s, &iov, 1, end, NULL, &end) != cre_MATCH) {
+            // a word boundary at the end may still complete one
+            if (cre_srch_end(s) != cre_MATCH) break;
+            end = len;
+            last = true;
+        }
+        if (*noffs >= *cap) {
+            *cap = 2 * *cap + 64;
+            *offs = realloc(*offs, sizeof(**offs) * *cap);
+        }
+        (*offs)[(*noffs)++] = end;
+    }
+    if (data) munmap(data, len);
+    return 0;
+}
+
+// serve the requests on a connection, until it is closed (or sends a bad request)
+static void
+daemon_serve(struct daemon* D, int fd) {
+    struct daemon_req rq;
+    char* src = NULL;
+    char* path = NULL;
+    uint64_t* offs = NULL;
+    size_t cap = 0;
+    uint32_t i;
+    while (sock_read(fd, &rq, sizeof(rq)) && rq.magic == DAEMON_MAGIC && rq.pat_len < (1 << 24)) {
+        src = realloc(src, rq.pat_len + 1);
+        if (!sock_read(fd, src, rq.pat_len)) break;
+        src[rq.pat_len] = '\0';
+
+        struct daemon_res rs = { DAEMON_MAGIC, 0 };
+        struct daemon_pat* P = NULL;
+        char* err = NULL;
+        cre_srch* s = NULL;
+        if (rq.k < -1 || rq.k > DAEMON_MAX_K) {
+            // NOTE: 'k' is from the client, so it has to be checked before it is used
+            err = strdup("-k should be from -1 to 64");
+        } else {
+            s = daemon_get(D, src, rq.k, &P, &err);
+        }
+        if (!s) {
+            rs.err_len = strlen(err);
+            bool ok = sock_write(fd, &rs, sizeof(rs)) && sock_write(fd, err, rs.err_len);
+            free(err);
+            if (!ok) break;
+            // NOTE: the paths still have to be read, to get to the next request
+            for (i = 0; i < rq.npaths; ++i) {
+                uint32_t plen;
+                if (!sock_read(fd, &plen, sizeof(plen)) || plen > PATH_MAX) break;
+                path = realloc(path, plen + 1);
+                if (!sock_read(fd, path, plen)) break;
+            }
+            if (i < rq.npaths) break;
+            continue;
+        }
+        bool ok = sock_write(fd, &rs, sizeof(rs));
+        for (i = 0; ok && i < rq.npaths; ++i) {
+            uint32_t plen;
+            ok = sock_read(fd, &plen, sizeof(plen)) && plen <= PATH_MAX;
+            if (!ok) break;
+            path = realloc(path, plen + 1);
+            ok = sock_read(fd, path, plen);
+            if (!ok) break;
+            path[plen] = '\0';
+
+            struct daemon_file rf = { 0, 0, 0 };
+            size_t noffs = 0;
+            rf.err = daemon_search(s, path, &offs, &noffs, &cap);
+            rf.nmatches = noffs;
+            ok = sock_write(fd, &rf, sizeof(rf)) && sock_write(fd, offs, sizeof(*offs) * noffs);
+        }
+        daemon_put(D, P, s);
+        if (!ok) break;
+    }
+    free(src);
+    free(path);
+    free(offs);
+    close(fd);
+}
+
+// thread that serves the connections in the queue, forever
+static void*
+daemon_run(void* arg) {
+    struct daemon* D = arg;
+    while (true) {
+        pthread_mutex_lock(&D->lock);
+        while (D->qlen == 0) pthread_cond_wait(&D->cond, &D->lock);
+        int fd = D->queue[D->qhead];
+        D->qhead = (D->qhead + 1) % D->qcap;
+        D->qlen--;
+        pthread_mutex_unlock(&D->lock);
+        daemon_serve(D, fd);
+    }
+    return NULL;
+}
+
+// serve searches on the Unix socket 'sock', forever, with a thread for each CPU
+static int
+daemon_main(char* argv0, const char* sock) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: %s: socket path is too long\n", argv0, sock);
+        return 1;
+    }
+    strcpy(addr.sun_path, sock);
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        perror(argv0);
+        return 1;
+    }
+    // NOTE: a socket left over from a daemon that stopped would make 'bind' fail, so it is
+    //         removed (but nothing else is, in case the path is wrong)
+    struct stat st;
+    if (lstat(sock, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            fprintf(stderr, "%s: %s: exists, and isn't a socket\n", argv0, sock);
+            return 1;
+        }
+        unlink(sock);
+    }
+    if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lfd, 64) != 0) {
+        perror(sock);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    struct daemon D;
+    memset(&D, 0, sizeof(D));
+    pthread_mutex_init(&D.lock, NULL);
+    pthread_cond_init(&D.cond, NULL);
+    D.qcap = 64;
+    D.queue = malloc(sizeof(*D.queue) * D.qcap);
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN), i;
+    if (nthreads < 1) nthreads = 1;
+    for (i = 0; i < nthreads; ++i) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, daemon_run, &D) != 0) {
+            if (i == 0) {
+                perror(argv0);
+                return 1;
+            }
+            break;
+        }
+        pthread_detach(t);
+    }
+
+    // then, queue each connection for a thread
+    while (true) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror(sock);
+            return 1;
+        }
+        pthread_mutex_lock(&D.lock);
+        if (D.qlen >= D.qcap) {
+            // grow the ring, unwrapping it
+            int* q = malloc(sizeof(*q) * 2 * D.qcap);
+            for (i = 0; i < D.qlen; ++i) {
+                q[i] = D.queue[(D.qhead + i) % D.qcap];
+            }
+            free(D.queue);
+            D.queue = q;
+            D.qhead = 0;
+            D.qcap *= 2;
+        }
+        D.queue[(D.qhead + D.qlen++) % D.qcap] = fd;
+        pthread_cond_signal(&D.cond);
+        pthread_mutex_unlock(&D.lock);
+    }
+}
+
+// search files with the daemon on the Unix socket 'sock', printing the same as searching
+//   them here would
+static int
+daemon_client(char* argv0, const char* sock, const char* src, int k, int nfiles, char** paths) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: %s: socket path is too long\n", argv0, sock);
+        return 1;
+    }
+    strcpy(addr.sun_path, sock);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        perror(sock);
+        return 1;
+    }
+
+    // send the request, with absolute paths (since the daemon has its own directory)
+    struct daemon_req rq = { DAEMON_MAGIC, k, strlen(src), nfiles };
+    bool ok = sock_write(fd, &rq, sizeof(rq)) && sock_write(fd, src, rq.pat_len);
+    int i, res = 0;
+    for (i = 0; ok && i < nfiles; ++i) {
+        char* abs = realpath(paths[i], NULL);
+        const char* p = abs ? abs : paths[i];
+        uint32_t plen = strlen(p);
+        ok = sock_write(fd, &plen, sizeof(plen)) && sock_write(fd, p, plen);
+        free(abs);
+    }
+
+    // then, print the response
+    struct daemon_res rs;
+    ok = ok && sock_read(fd, &rs, sizeof(rs)) && rs.magic == DAEMON_MAGIC;
+    if (ok && rs.err_len > 0) {
+        char* err = malloc(rs.err_len + 1);
+        ok = sock_read(fd, err, rs.err_len);
+        err[ok ? rs.err_len : 0] = '\0';
+        fprintf(stderr, "%s: %s: %s\n", argv0, sock, err);
+        free(err);
+        close(fd);
+        return 1;
+    }
+    for (i = 0; ok && i < nfiles; ++i) {
+        struct daemon_file rf;
+        uint64_t j, off;
+        ok = sock_read(fd, &rf, sizeof(rf));
+        for (j = 0; ok && j < rf.nmatches; ++j) {
+            ok = sock_read(fd, &off, sizeof(off));
+            if (ok) printf("MATCH\n");
+        }
+        if (ok && rf.err != 0) {
+            fprintf(stderr, "%s: %s\n", paths[i], strerror(rf.err));
+            res = 1;
+        }
+    }
+    close(fd);
+    if (!ok) {
+        fprintf(stderr, "%s: %s: lost the connection to the daemon\n", argv0, sock);
+        return 1;
+    }
+    return res;
+}
+
+#ifdef __linux__
+
+// a file being followed (see 'follow')
+struct follow_file {
+
+    // path, and its base name (i.e. the part after the last '/')
+    const char* path;
+    const char* name;
+
+    // the open file (or -1 if it was rotated away), and the watch on it
+    int fd, wd;
+
+    // the watch on its directory, for noticing when it's created again
+    int dwd;
+
+    // how much of it has been searched, and the searcher's state at that point
+    off_t off;
+    void* state;
+
+};
+
+// state of 'follow'
+struct follow {
+
+    // the searcher, which is shared by every file (each one has its own saved state)
+    cre_srch* srch;
+
+    // the inotify instance
+    int ino;
+
+    // the files being followed
+    int nfiles;
+    struct follow_file* files;
+
+    // the file index for each watch descriptor (or -1 if it isn't a file's watch)
+    int nwd;
+    int* bywd;
+
+    // buffer to read into
+    char* buf;
+    size_t bufsz;
+
+};
+
+// search whatever was appended to a file since it was last read
+static void
+follow_read(struct follow* F, struct follow_file* f) {
+    struct stat st;
+    if (f->fd < 0 || fstat(f->fd, &st) != 0) return;
+    if (st.st_size < f->off) {
+        // it was truncated, so start over
+        f->off = 0;
+        cre_srch_reset(F->srch);
+        cre_srch_save(F->srch, f->state);
+    }
+    cre_srch_load(F->srch, f->state);
+    ssize_t sz;
+    while ((sz = pread(f->fd, F->buf, F->bufsz, f->off)) > 0) {
+        struct iovec iov = { F->buf, sz };
+        size_t end = 0;
+        while (cre_search_iov(F->srch, &iov, 1, end, NULL, &end) == cre_MATCH) {
+            printf("%s:%lld: MATCH\n", f->path, (long long)f->off + (long long)end);
+        }
+        f->off += sz;
+    }
+    cre_srch_save(F->srch, f->state);
+    fflush(stdout);
+}
+
+// stop reading a file (after reading the rest of it), since it was rotated away
+static void
+follow_close(struct follow* F, struct follow_file* f) {
+    if (f->fd < 0) return;
+    follow_read(F, f);
+    close(f->fd);
+    inotify_rm_watch(F->ino, f->wd);
+    if (f->wd < F->nwd) F->bywd[f->wd] = -1;
+    f->fd = f->wd = -1;
+}
+
+// open a file, if it exists and isn't the one already open, and search it from the start
+static void
+follow_open(struct follow* F, struct follow_file* f) {
+    struct stat st, cur;
+    if (stat(f->path, &st) != 0) return;
+    if (f->fd >= 0) {
+        if (fstat(f->fd, &cur) == 0 && cur.st_dev == st.st_dev && cur.st_ino == st.st_ino) return;
+        follow_close(F, f);
+    }
+    f->fd = open(f->path, O_RDONLY);
+    if (f->fd < 0) return;
+    f->wd = inotify_add_watch(F->ino, f->path, IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+    if (f->wd >= F->nwd) {
+        int n = F->nwd, i;
+        F->nwd = 2 * f->wd + 16;
+        F->bywd = realloc(F->bywd, sizeof(*F->bywd) * F->nwd);
+        for (i = n; i < F->nwd; ++i) {
+            F->bywd[i] = -1;
+        }
+    }
+    if (f->wd >= 0) F->bywd[f->wd] = f - F->files;
+    f->off = 0;
+    cre_srch_reset(F->srch);
+    cre_srch_save(F->srch, f->state);
+    follow_read(F, f);
+}
+
+// search files, and then keep searching whatever is appended to them, forever
+// NOTE: rotated files are finished, and then followed again once they are re-created,
+//         and truncated files are searched from the start again
+static int
+follow(char* argv0, cre_srch* srch, int nfiles, char** paths) {
+    struct follow F;
+    int i;
+    F.srch = srch;
+    F.ino = inotify_init1(IN_CLOEXEC);
+    if (F.ino < 0) {
+        perror(argv0);
+        return 1;
+    }
+    F.nfiles = nfiles;
+    F.files = malloc(sizeof(*F.files) * nfiles);
+    F.nwd = 0;
+    F.bywd = NULL;
+    F.bufsz = 1 << 16;
+    F.buf = malloc(F.bufsz);
+
+    for (i = 0; i < nfiles; ++i) {
+        struct follow_file* f = &F.files[i];
+        f->path = paths[i];
+        const char* slash = strrchr(f->path, '/');
+        f->name = slash ? slash + 1 : f->path;
+        f->fd = f->wd = -1;
+        f->state = malloc(cre_srch_state_size(srch));
+
+        // watch the directory too, for when the file is (re-)created
+        char* dir = slash ? strndup(f->path, slash == f->path ? 1 : slash - f->path) : strdup(".");
+        f->dwd = inotify_add_watch(F.ino, dir, IN_CREATE | IN_MOVED_TO);
+        if (f->dwd < 0) perror(dir);
+        free(dir);
+        follow_open(&F, f);
+        if (f->fd < 0) fprintf(stderr, "%s: %s: waiting for it to be created\n", argv0, f->path);
+    }
+
+    // then, handle events forever
+    char evbuf[sizeof(struct inotify_event) + NAME_MAX + 1] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (true) {
+        ssize_t sz = read(F.ino, evbuf, sizeof(evbuf));
+        if (sz < 0) {
+            if (errno == EINTR) continue;
+            perror(argv0);
+            return 1;
+        }
+        char* p = evbuf;
+        while (p < evbuf + sz) {
+            struct inotify_event* ev = (struct inotify_event*)p;
+            p += sizeof(*ev) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                // events were dropped, so check everything
+                for (i = 0; i < F.nfiles; ++i) {
+                    follow_open(&F, &F.files[i]);
+                    follow_read(&F, &F.files[i]);
+                }
+                continue;
+            }
+            int fi = ev->wd >= 0 && ev->wd < F.nwd ? F.bywd[ev->wd] : -1;
+            if (fi >= 0) {
+                if (ev->mask & IN_MODIFY) follow_read(&F, &F.files[fi]);
+                if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF)) follow_close(&F, &F.files[fi]);
+            }
+            if (ev->len > 0 && (ev->mask & (IN_CREATE | IN_MOVED_TO))) {
+                for (i = 0; i < F.nfiles; ++i) {
+                    if (F.files[i].dwd == ev->wd && strcmp(F.files[i].name, ev->name) == 0) follow_open(&F, &F.files[i]);
+                }
+            }
+        }
+    }
+}
+
+#endif // __linux__
 
 int
 main(int argc, char** argv) {
-    if (argc < 3) {
-        fprintf(stderr, "usage: %s [pat] args...", argv[0]);
+    // parse options
+    bool opt_explain = false, opt_overlap = false, opt_follow = false;
+    char* opt_cache = NULL;
+    char* opt_lits = NULL;
+    char* opt_sep = NULL;
+    char* opt_record = NULL;
+    char* opt_delim = "\\t";
+    char* opt_daemon = NULL;
+    char* opt_connect = NULL;
+    int opt_count_by = -1;
+    long opt_top = 10;
+    char* opt_since = NULL;
+    char* opt_until = NULL;
+    char* opt_ts = "\\d\\d\\d\\d-\\d\\d-\\d\\d([T ]\\d\\d(:\\d\\d(:\\d\\d([.,]\\d+)?)?)?)?";
+    int opt_field = 0;
+    int opt_k = -1;
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        char* arg = argv[i];
+        if (strcmp(arg, "--") == 0) {
+            i++;
+            break;
+        } else if (strcmp(arg, "--help") == 0) {
+            usage(argv[0]);
+            exit(0);
+        } else if (strcmp(arg, "--explain") == 0) {
+            opt_explain = true;
+        } else if (strcmp(arg, "--overlap") == 0) {
+            opt_overlap = true;
+        } else if (strcmp(arg, "--follow") == 0) {
+            opt_follow = true;
+        } else if (strcmp(arg, "--cache") == 0 && i + 1 < argc) {
+            opt_cache = argv[++i];
+        } else if (strcmp(arg, "-f") == 0 && i + 1 < argc) {
+            opt_lits = argv[++i];
+        } else if (strcmp(arg, "-k") == 0 && i + 1 < argc) {
+            opt_k = atoi(argv[++i]);
+            if (opt_k < -1) {
+                fprintf(stderr, "%s: -k should be at least 0 (or -1, to match exactly)\n", argv[0]);
+                exit(1);
+            }
+        } else if (strcmp(arg, "-z") == 0) {
+            opt_sep = "\\0";
+        } else if (strcmp(arg, "--sep") == 0 && i + 1 < argc) {
+            opt_sep = argv[++i];
+        } else if (strcmp(arg, "--record") == 0 && i + 1 < argc) {
+            opt_record = argv[++i];
+        } else if (strcmp(arg, "--field") == 0 && i + 1 < argc) {
+            opt_field = atoi(argv[++i]);
+            if (opt_field <= 0) {
+                fprintf(stderr, "%s: fields are numbered from 1\n", argv[0]);
+                exit(1);
+            }
+        } else if (strcmp(arg, "--delim") == 0 && i + 1 < argc) {
+            opt_delim = argv[++i];
+        } else if (strcmp(arg, "--count-by") == 0 && i + 1 < argc) {
+            opt_count_by = atoi(argv[++i]);
+        } else if (strcmp(arg, "--top") == 0 && i + 1 < argc) {
+            opt_top = atol(argv[++i]);
+        } else if (strcmp(arg, "--since") == 0 && i + 1 < argc) {
+            opt_since = argv[++i];
+        } else if (strcmp(arg, "--until") == 0 && i + 1 < argc) {
+            opt_until = argv[++i];
+        } else if (strcmp(arg, "--ts") == 0 && i + 1 < argc) {
+            opt_ts = argv[++i];
+        } else if (strcmp(arg, "--daemon") == 0 && i + 1 < argc) {
+            opt_daemon = argv[++i];
+        } else if (strcmp(arg, "--connect") == 0 && i + 1 < argc) {
+            opt_connect = argv[++i];
+        } else {
+            fprintf(stderr, "%s: unknown option '%s'\n", argv[0], arg);
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (opt_daemon) {
+        // patterns come from requests instead
+        return daemon_main(argv[0], opt_daemon);
+    }
+    if (opt_connect) {
+        // the daemon searches instead
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            exit(1);
+        }
+        return daemon_client(argv[0], opt_connect, argv[i], opt_k, argc - i - 1, argv + i + 1);
+    }
+    if (opt_lits) {
+        // literals instead of a pattern
+        if (i >= argc) {
+            usage(argv[0]);
+            exit(1);
+        }
+        return search_lits(argv[0], opt_lits, argc - i, argv + i);
+    }
+    if (i >= argc || (!opt_explain && i + 1 >= argc)) {
+        usage(argv[0]);
         exit(1);
     }
 
     // initialize search pattern
     cre_pat pat;
-    cre_pat_init(&pat, argv[1]);
+    char* err = cre_pat_init(&pat, argv[i]);
+    if (err) {
+        fprintf(stderr, "%s: bad pattern: %s\n", argv[0], err);
+        free(err);
+        exit(1);
+    }
+    if (opt_explain) {
+        explain(&pat);
+        cre_pat_free(&pat);
+        return 0;
+    }
 
-    // initialize simulator as well
-    cre_sim sim;
-    cre_sim_init(&sim, &pat);
+    if (opt_count_by >= 0) {
+        // counts of a group instead of matches
+        if (opt_count_by > pat.ngroups) {
+            fprintf(stderr, "%s: the pattern only has %d groups\n", argv[0], pat.ngroups);
+            exit(1);
+        }
+        if (opt_top < 0) {
+            fprintf(stderr, "%s: --top should be at least 0\n", argv[0]);
+            exit(1);
+        }
+        if (opt_k >= 0 || opt_overlap || opt_follow || opt_cache || opt_sep || opt_record || opt_field > 0 || opt_since || opt_until) {
+            fprintf(stderr, "%s: --count-by can only be used with --top\n", argv[0]);
+            exit(1);
+        }
+        int res = count_by(argv[0], &pat, opt_count_by, opt_top, argc - i - 1, argv + i + 1);
+        cre_pat_free(&pat);
+        return res;
+    }
+
+    // initialize searcher as well (which matches approximately, if requested)
+    cre_srch srch;
+    err = cre_srch_init(&srch, &pat, opt_k);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", argv[0], err);
+        free(err);
+        exit(1);
+    }
+    if (opt_since || opt_until) {
+        // only the lines in a time window
+        if (opt_overlap || opt_follow || opt_cache || opt_sep || opt_record || opt_field > 0) {
+            fprintf(stderr, "%s: --since and --until can't be used with --overlap, --follow, --cache or records\n", argv[0]);
+            exit(1);
+        }
+        struct window W;
+        cre_pat ts;
+        err = cre_pat_init(&ts, opt_ts);
+        if (err) {
+            fprintf(stderr, "%s: bad timestamp pattern: %s\n", argv[0], err);
+            free(err);
+            exit(1);
+        }
+        cre_sim_init(&W.ts, &ts);
+        W.since = opt_since;
+        W.since_len = opt_since ? strlen(opt_since) : 0;
+        W.until = opt_until;
+        W.until_len = opt_until ? strlen(opt_until) : 0;
+        int res = search_window(argv[0], &srch, &W, argc - i - 1, argv + i + 1);
+        cre_sim_free(&W.ts);
+        cre_pat_free(&ts);
+        cre_srch_free(&srch);
+        cre_pat_free(&pat);
+        return res;
+    }
+    if (opt_sep || opt_record || opt_field > 0) {
+        // records instead of whole files (which are lines, if only a field is given)
+        struct records R;
+        cre_pat start;
+        R.sep = NULL;
+        R.field = opt_field;
+        size_t dlen;
+        char* delim = unescape(opt_delim, &dlen);
+        if (dlen != 1) {
+            fprintf(stderr, "%s: the field delimiter should be one byte\n", argv[0]);
+            exit(1);
+        }
+        R.delim = delim[0];
+        free(delim);
+        if (!opt_sep && !opt_record) opt_sep = "\\n";
+        if (opt_record) {
+            err = cre_pat_init(&start, opt_record);
+            if (err) {
+                fprintf(stderr, "%s: bad record pattern: %s\n", argv[0], err);
+                free(err);
+                exit(1);
+            }
+            cre_sim_init(&R.start, &start);
+        } else {
+            R.sep = unescape(opt_sep, &R.sep_len);
+            if (R.sep_len == 0) {
+                fprintf(stderr, "%s: the record separator is empty\n", argv[0]);
+                exit(1);
+            }
+        }
+        int res = search_records(argv[0], &srch, &R, argc - i - 1, argv + i + 1);
+        if (opt_record) {
+            cre_sim_free(&R.start);
+            cre_pat_free(&start);
+        }
+        free((char*)R.sep);
+        cre_srch_free(&srch);
+        cre_pat_free(&pat);
+        return res;
+    }
+    if (opt_follow) {
+#ifdef __linux__
+        return follow(argv[0], &srch, argc - i - 1, argv + i + 1);
+#else
+        fprintf(stderr, "%s: --follow needs inotify, which is only on Linux\n", argv[0]);
+        exit(1);
+#endif
+    }
 
     // buffering size
-    int bufsz = 4096;
+    size_t bufsz = 4096;
     char* buf = malloc(bufsz);
 
-    int i, j;
-    for (i = 2; i < argc; i++) {
+    // overlapping matches may span buffers, so whole files are read and searched at once
+    if (opt_overlap) {
+        cre_ovl ovl;
+        cre_ovl_init(&ovl, &pat, 0);
+        for (i++; i < argc; i++) {
+            char* arg = argv[i];
+            long len = read_all(arg, &buf, &bufsz);
+            if (len < 0) {
+                perror(arg);
+                exit(1);
+            }
+            if (cre_ovl_search(&ovl, buf, len, NULL, print_ovl, NULL) == cre_BUDGET) {
+                fprintf(stderr, "%s: %s: too many DFA states\n", argv[0], arg);
+            }
+        }
+        cre_ovl_free(&ovl);
+    }
+
+    // load the result cache, if requested
+    struct cache cache = { 0 };
+    uint64_t hash = 0xcbf29ce484222325ULL, *offs = NULL;
+    size_t state_size = cre_srch_state_size(&srch), noffs = 0, offs_cap = 0, j;
+    if (opt_cache) {
+        cache_load(&cache, opt_cache);
+        // hash the pattern, and the options that change the results
+        const char* p;
+        for (p = pat.src; *p; ++p) {
+            hash = (hash ^ (unsigned char)*p) * 0x100000001b3ULL;
+        }
+        hash = (hash ^ (uint64_t)(opt_k + 1)) * 0x100000001b3ULL;
+    }
+
+    for (i++; !opt_overlap && i < argc; i++) {
         // assume file
         // TODO: also check if it's a directory, and recursively search it
         char* arg = argv[i];
@@ -505,26 +8778,90 @@ main(int argc, char** argv) {
             perror(arg);
             exit(1);
         }
+        cre_srch_reset(&srch);
+        uint64_t pos = 0, mtime = 0;
+        noffs = 0;
+
+        // check the cache first
+        struct stat st;
+        int ci = -1;
+        if (opt_cache && fstat(fileno(fp), &st) == 0) {
+            mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+            ci = cache_find(&cache, &st, hash);
+            struct cache_rec* r = ci >= 0 ? cache.recs[ci] : NULL;
+            if (r && r->size == (uint64_t)st.st_size && r->mtime == mtime) {
+                // unchanged, so it doesn't need to be read at all
+                for (j = 0; j < r->nmatches + r->eoi; ++j) {
+                    printf("MATCH\n");
+                }
+                fclose(fp);
+                continue;
+            }
+            if (r && r->size < (uint64_t)st.st_size && r->state_size == state_size && fseeko(fp, r->size, SEEK_SET) == 0) {
+                // appended to, so continue from where it was last searched
+                for (j = 0; j < r->nmatches; ++j) {
+                    printf("MATCH\n");
+                }
+                noffs = r->nmatches;
+                if (noffs > offs_cap) {
+                    offs_cap = 2 * noffs;
+                    offs = realloc(offs, sizeof(*offs) * offs_cap);
+                }
+                if (noffs > 0) memcpy(offs, cache_offs(r), sizeof(*offs) * noffs);
+                cre_srch_load(&srch, cache_state(r));
+                pos = r->size;
+            }
+        }
+
         // handle buffers of the file
         while (true) {
             // try to read a buffer, up to 'bufsz'
             size_t sz = fread(buf, 1, bufsz, fp);
             if (sz == 0) break;
 
-            for (j = 0; j < sz; ++j) {
-                if (cre_sim_feedc(&it, buf[j])) {
-                    // found match
-                    printf("MATCH\n");
+            struct iovec iov = { buf, sz };
+            size_t off = 0;
+            while (cre_search_iov(&srch, &iov, 1, off, NULL, &off) == cre_MATCH) {
+                // found match
+                printf("MATCH\n");
+                if (opt_cache) {
+                    if (noffs >= offs_cap) {
+                        offs_cap = 2 * offs_cap + 64;
+                        offs = realloc(offs, sizeof(*offs) * offs_cap);
+                    }
+                    offs[noffs++] = pos + off;
                 }
             }
+            pos += sz;
         }
-
         fclose(fp);
+        bool eoi = cre_srch_end(&srch) == cre_MATCH;
+        if (eoi) printf("MATCH\n");
+
+        if (opt_cache && mtime > 0) {
+            // remember the results (and where the search stopped) for next time
+            size_t len = sizeof(struct cache_rec) + ((state_size + 7) & ~(size_t)7) + sizeof(*offs) * noffs;
+            struct cache_rec* r = calloc(1, len);
+            r->len = len;
+            r->dev = st.st_dev;
+            r->ino = st.st_ino;
+            r->size = pos;
+            r->mtime = mtime;
+            r->hash = hash;
+            r->nmatches = noffs;
+            r->state_size = state_size;
+            r->eoi = eoi;
+            cre_srch_save(&srch, cache_state(r));
+            if (noffs > 0) memcpy(cache_offs(r), offs, sizeof(*offs) * noffs);
+            cache_put(&cache, ci, r);
+        }
     }
+    if (opt_cache) cache_save(&cache, argv[0]);
+    free(offs);
 
     // free resources
     free(buf);
-    cre_sim_free(&it);
+    cre_srch_free(&srch);
     cre_pat_free(&pat);
 }
 